@@ -142,6 +142,19 @@ typedef struct _tai_service_method_table_t
 
 } tai_service_method_table_t;
 
+/**
+ * @brief Flag of tai_api_initialize() for a warm restart
+ *
+ * The adapter host restarted while the hardware kept running. The adapter
+ * must not reset the hardware it shares between the modules while it
+ * initializes. The flag alone doesn't make any module warm: the adapter host
+ * creates the modules it had before the restart again with the attributes
+ * they had and #TAI_MODULE_ATTR_WARM_RESTART, and the adapter reattaches only
+ * to those without resetting or re-initializing them. The other modules,
+ * including the ones created later, go through the cold initialization.
+ */
+#define TAI_API_INITIALIZE_FLAG_WARM_RESTART (1ULL << 0)
+
 /**
  * @brief Adapter module initialization call
  *
@@ -149,7 +162,7 @@ typedef struct _tai_service_method_table_t
  * initialize any data/control structures that may be necessary during
  * subsequent TAI operations.
  *
- * @param[in] flags Reserved for future use, must be zero
+ * @param[in] flags Bitwise OR of TAI_API_INITIALIZE_FLAG_*. Zero for a cold start
  * @param[in] services Methods table with services provided by adapter host
  *
  * @return #TAI_STATUS_SUCCESS on success, failure status code on error
@@ -243,6 +243,20 @@ typedef enum _tai_module_attr_t
      */
     TAI_MODULE_ATTR_NOTIFY,
 
+    /**
+     * @brief The module kept running while the adapter host restarted
+     *
+     * Set by the adapter host when it creates a module again after
+     * tai_api_initialize() with #TAI_API_INITIALIZE_FLAG_WARM_RESTART. The
+     * adapter reattaches to the module without resetting or re-initializing
+     * it. The modules created without it go through the cold initialization
+     *
+     * @type bool
+     * @flags CREATE_ONLY
+     * @default false
+     */
+    TAI_MODULE_ATTR_WARM_RESTART,
+
     /**
      * @brief End of attributes
      */
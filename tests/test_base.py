@@ -2,9 +2,14 @@ import unittest
 import subprocess as sp
 import threading
 import os
+import errno
 import time
+import json
+import signal
 import taish
+from taish import taish_pb2
 import asyncio
+import grpc
 
 TAI_TEST_MODULE_LOCATION = os.environ.get("TAI_TEST_MODULE_LOCATION", "")
 if not TAI_TEST_MODULE_LOCATION:
@@ -18,21 +23,35 @@ TAI_TEST_TAISH_SERVER_PORT = os.environ.get("TAI_TEST_TAISH_SERVER_PORT", "")
 if not TAI_TEST_TAISH_SERVER_PORT:
     TAI_TEST_TAISH_SERVER_PORT = taish.DEFAULT_SERVER_PORT
 
+TAI_TEST_TAISH_SERVER_UNIX_PATH = "/tmp/taish_test.sock"
+TAI_TEST_TAISH_SERVER_RECORD_PATH = "/tmp/taish_test.rec"
+TAI_TEST_TAISH_SERVER_RELOAD_CONFIG_PATH = "/tmp/taish_test_reload.json"
+TAI_TEST_TAISH_SERVER_CONFIG_CACHE_PATH = "/tmp/taish_test_config.cache"
+TAI_TEST_TAISH_SERVER_JOURNAL_PATH = "/tmp/taish_test_journal.json"
+TAI_TEST_TAISH_SERVER_GATE_PATH = "/tmp/taish_test.gate"
+
 TAI_TEST_NO_LOCAL_TAISH_SERVER = (
     True if os.environ.get("TAI_TEST_NO_LOCAL_TAISH_SERVER", "") else False
 )
 
 
-def output_reader(proc):
+def output_reader(proc, lines=None):
     for line in iter(proc.stdout.readline, b""):
         print("taish-server: {}".format(line.decode("utf-8")), end="")
+        if lines is not None:
+            lines.append(line.decode("utf-8"))
+
+
+def gate_env():
+    # a module custom set of the basic adapter waits at the FIFO at this path, when it exists
+    return dict(os.environ, TAI_BASIC_GATE=TAI_TEST_TAISH_SERVER_GATE_PATH)
 
 
 class TestTAI(unittest.IsolatedAsyncioTestCase):
     def setUp(self):
         if TAI_TEST_NO_LOCAL_TAISH_SERVER:
             return
-        proc = sp.Popen("taish_server", stderr=sp.STDOUT, stdout=sp.PIPE)
+        proc = sp.Popen("taish_server", stderr=sp.STDOUT, stdout=sp.PIPE, env=gate_env())
         self.d = threading.Thread(target=output_reader, args=(proc,))
         self.d.start()
         self.proc = proc
@@ -358,6 +377,47 @@ class TestTAI(unittest.IsolatedAsyncioTestCase):
 
         await cli.close()
 
+    async def test_watch_topology(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        q = asyncio.Queue()
+        task = asyncio.create_task(cli.watch_topology(lambda msg: q.put_nowait(msg)))
+
+        msg = await asyncio.wait_for(q.get(), timeout=5)
+        self.assertTrue(msg.reset)
+        version = msg.version
+        modules = [
+            e.location for e in msg.events if e.object_type == taish_pb2.MODULE
+        ]
+        self.assertIn(TAI_TEST_MODULE_LOCATION, modules)
+
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+        netif = m.get_netif()
+        await cli.remove(netif.oid)
+        msg = await asyncio.wait_for(q.get(), timeout=5)
+        self.assertFalse(msg.reset)
+        self.assertEqual(msg.version, version + 1)
+        self.assertEqual(len(msg.events), 1)
+        e = msg.events[0]
+        self.assertEqual(e.type, taish_pb2.TOPOLOGY_REMOVE)
+        self.assertEqual(e.object_type, taish_pb2.NETIF)
+        self.assertEqual(e.location, TAI_TEST_MODULE_LOCATION)
+        self.assertEqual(e.oid, netif.oid)
+
+        netif = await m.create_netif(index=0)
+        msg = await asyncio.wait_for(q.get(), timeout=5)
+        self.assertEqual(msg.version, version + 2)
+        self.assertEqual(msg.events[0].type, taish_pb2.TOPOLOGY_ADD)
+        self.assertEqual(msg.events[0].oid, netif.oid)
+
+        # ListModule is served from the same snapshot
+        res = [r async for r in cli.stub.ListModule(taish_pb2.ListModuleRequest())]
+        self.assertTrue(all(r.version == version + 2 for r in res))
+
+        task.cancel()
+        await cli.close()
+
     async def test_module_create_hostif(self):
         await self.test_remove()
         cli = taish.AsyncClient(
@@ -385,6 +445,340 @@ class TestTAI(unittest.IsolatedAsyncioTestCase):
         self.assertEqual(v[0], "shallow")
         self.assertEqual(v[1], "rs")
 
+    async def test_bulk_get(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+        hostif = m.get_hostif()
+        await hostif.set("fec-type", "rs")
+        loc = await m.get_attribute_metadata("location")
+        v = await cli.bulk_get(
+            [
+                (m, ["location", "num-host-interfaces"]),
+                (hostif, ["fec-type", "ethernet-in-fcs-errors", "loopback-type"]),
+                (0, [loc]),
+            ]
+        )
+        self.assertEqual(len(v), 3)
+        self.assertEqual(v[0], [TAI_TEST_MODULE_LOCATION, "2"])
+        self.assertEqual(v[1][0], "rs")
+        self.assertIsInstance(v[1][1], taish.TAIException)
+        self.assertEqual(v[1][1].msg, "attr-not-supported")
+        self.assertEqual(v[1][2], "none")
+        self.assertEqual(len(v[2]), 1)
+        self.assertIsInstance(v[2][0], taish.TAIException)
+        await cli.close()
+
+    async def hold_adapter(self, cli):
+        """Removes the modules other than the one under test in the background
+
+        A module removal holds the adapter lock of every module while the basic adapter
+        polls its FSM (up to 100ms). The modules are removed one after another so that
+        only one server worker is taken by the removals. The calls made meanwhile queue up.
+        """
+        modules = await cli.list()
+        others = [m for l, m in modules.items() if l != TAI_TEST_MODULE_LOCATION]
+        for m in others:
+            for i in m.netifs + m.hostifs:
+                await cli.remove(i.oid)
+
+        async def remove():
+            for m in others:
+                await cli.remove(m.oid)
+
+        task = asyncio.create_task(remove())
+        await asyncio.sleep(0.02)
+        return task
+
+    async def test_get_coalesced(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+        netif = m.get_netif()
+        await netif.set("output-power", -3)
+        meta = await netif.get_attribute_metadata("output-power")
+        before = (await cli.get_stats())["singleflight.coalesced"]
+        # the gets queued behind the removal join the one which reads
+        held = await self.hold_adapter(cli)
+        v = await asyncio.gather(*[netif.get(meta) for _ in range(32)])
+        await held
+        self.assertEqual(len(v), 32)
+        self.assertEqual(len(set(v)), 1)
+        self.assertEqual(round(float(v[0])), -3)
+        stats = await cli.get_stats()
+        self.assertGreater(stats["singleflight.coalesced"], before)
+        await cli.close()
+
+    async def test_get_deadline(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+        netif = m.get_netif()
+        await netif.set("output-power", -3)
+        meta = await netif.get_attribute_metadata("output-power")
+        req = taish_pb2.GetAttributeRequest(oid=netif.oid)
+        req.attributes.add(attr_id=meta.attr_id)
+        # a call which doesn't wait for the adapter lock longer than its deadline succeeds
+        res = await cli.stub.GetAttribute(req, timeout=5)
+        self.assertEqual(len(res.attributes), 1)
+
+        # a call which joins the read of a call without deadline still gives up at its own
+        before = (await cli.get_stats())["shed.expired"]
+        held = await self.hold_adapter(cli)
+        reader = asyncio.create_task(netif.get(meta))
+        await asyncio.sleep(0.01)
+        with self.assertRaises(grpc.aio.AioRpcError) as cm:
+            await cli.stub.GetAttribute(req, timeout=0.05)
+        self.assertEqual(cm.exception.code(), grpc.StatusCode.DEADLINE_EXCEEDED)
+        self.assertEqual(round(float(await reader)), -3)
+        await held
+        stats = await cli.get_stats()
+        self.assertGreater(stats["shed.expired"], before)
+        await cli.close()
+
+    async def test_priority(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+        netif = m.get_netif()
+        await netif.set("output-power", -3)
+        self.assertEqual(round(float(await netif.get("output-power"))), -3)
+        meta = await netif.get_attribute_metadata("output-power")
+        req = taish_pb2.SetAttributeRequest(oid=netif.oid)
+        req.attributes.add(attr_id=meta.attr_id, value="-4")
+        # the class of a call can be overridden by the metadata
+        await cli.stub.SetAttribute(req, metadata=(("taish-priority", "metadata"),))
+        self.assertEqual(round(float(await netif.get("output-power"))), -4)
+
+        # the time spent waiting for the adapter is measured per class
+        hs = await cli.get_histograms()
+        for c in ["control", "get", "metadata"]:
+            self.assertTrue(
+                any(h.name == "queue_wait_us" and h.label == c for h in hs)
+            )
+        await cli.close()
+
+    async def test_priority_order(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+        netif = m.get_netif()
+        meta = await netif.get_attribute_metadata("output-power")
+        req = taish_pb2.SetAttributeRequest(oid=netif.oid)
+        req.attributes.add(attr_id=meta.attr_id, value="-4")
+        if TAI_TEST_NO_LOCAL_TAISH_SERVER:
+            self.skipTest("needs the gate of a local taish_server")
+        if os.path.exists(TAI_TEST_TAISH_SERVER_GATE_PATH):
+            os.remove(TAI_TEST_TAISH_SERVER_GATE_PATH)
+        os.mkfifo(TAI_TEST_TAISH_SERVER_GATE_PATH)
+        self.addCleanup(os.remove, TAI_TEST_TAISH_SERVER_GATE_PATH)
+
+        # the module custom set holds the module until the gate is opened. a set overtakes
+        # the get queued before it meanwhile, so the get reads the value set
+        await netif.set("output-power", -3)
+        held = asyncio.create_task(m.set("custom", "true"))
+        # the FIFO opens for writing once the adapter waits at the gate
+        until = time.time() + 5
+        while True:
+            try:
+                fd = os.open(TAI_TEST_TAISH_SERVER_GATE_PATH, os.O_WRONLY | os.O_NONBLOCK)
+                break
+            except OSError as e:
+                if e.errno != errno.ENXIO or time.time() > until:
+                    raise
+                await asyncio.sleep(0.01)
+        # both are queued well within the 100ms a waiter can be overtaken for
+        get = asyncio.create_task(netif.get(meta))
+        await asyncio.sleep(0.02)
+        set_ = asyncio.ensure_future(cli.stub.SetAttribute(req))
+        await asyncio.sleep(0.02)
+        self.assertFalse(get.done())
+        os.write(fd, b"\0")
+        os.close(fd)
+        await asyncio.gather(held, set_)
+        self.assertEqual(round(float(await get)), -4)
+
+        # the gets are not starved by the sets made back to back
+        async def sets(until):
+            while time.time() < until:
+                await cli.stub.SetAttribute(req)
+
+        until = time.time() + 1
+        load = asyncio.gather(*[sets(until) for _ in range(4)])
+        for _ in range(10):
+            v = await asyncio.wait_for(netif.get(meta), timeout=0.5)
+            self.assertEqual(round(float(v)), -4)
+        await load
+        await cli.close()
+
+    async def test_typed_value(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+        self.assertEqual(await m.get("location", typed=True), TAI_TEST_MODULE_LOCATION)
+        self.assertEqual(await m.get("num-host-interfaces", typed=True), 2)
+
+        netif = m.get_netif()
+        meta = await netif.get_attribute_metadata("output-power")
+        req = taish_pb2.SetAttributeRequest()
+        req.oid = netif.oid
+        a = req.attributes.add()
+        a.attr_id = meta.attr_id
+        a.typed_value.flt = -5
+        c = cli.stub.SetAttribute(req)
+        await c
+        taish.check_metadata(await c.trailing_metadata())
+        self.assertEqual(round(await netif.get("output-power", typed=True)), -5)
+        self.assertEqual(round(float(await netif.get("output-power"))), -5)
+
+        # type mismatch
+        a.typed_value.u32 = 1
+        c = cli.stub.SetAttribute(req)
+        await c
+        with self.assertRaises(taish.TAIException):
+            taish.check_metadata(await c.trailing_metadata())
+
+        v = await cli.bulk_get([(netif, [meta])], typed=True)
+        self.assertEqual(round(v[0][0]), -5)
+        await cli.close()
+
+    async def test_monitor(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+        q = asyncio.Queue()
+        task = asyncio.create_task(
+            m.monitor("notify", lambda obj, meta, msg: q.put_nowait(msg))
+        )
+        msg = await asyncio.wait_for(q.get(), timeout=5)
+        self.assertNotEqual(len(msg.attrs), 0)
+        task.cancel()
+
+        # subscribe again after the cancellation
+        task = asyncio.create_task(
+            m.monitor("notify", lambda obj, meta, msg: q.put_nowait(msg))
+        )
+        msg = await asyncio.wait_for(q.get(), timeout=5)
+        self.assertNotEqual(len(msg.attrs), 0)
+        task.cancel()
+
+        # the smallest queue still delivers the latest values
+        task = asyncio.create_task(
+            m.monitor(
+                "notify",
+                lambda obj, meta, msg: q.put_nowait(msg),
+                queue_size=1,
+                coalesce=True,
+            )
+        )
+        msg = await asyncio.wait_for(q.get(), timeout=5)
+        self.assertNotEqual(len(msg.attrs), 0)
+        task.cancel()
+
+        stats = await cli.get_stats()
+        self.assertIn("monitor.dropped", stats)
+        self.assertIn("monitor.coalesced", stats)
+
+        await cli.close()
+
+    async def test_monitor_filter(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+        meta = await cli.get_attribute_metadata(
+            taish_pb2.MODULE, "num-host-interfaces", oid=m.oid
+        )
+        q = asyncio.Queue()
+        # the basic adapter notifies num-host-interfaces every second.
+        # the value never changes, so only the first one passes the deadband
+        task = asyncio.create_task(
+            m.monitor(
+                "notify",
+                lambda obj, meta, msg: q.put_nowait(msg),
+                filters=[("num-host-interfaces", 0.5, 0)],
+            )
+        )
+        msg = await asyncio.wait_for(q.get(), timeout=5)
+        self.assertEqual([a.attr_id for a in msg.attrs], [meta.attr_id])
+        with self.assertRaises(asyncio.TimeoutError):
+            await asyncio.wait_for(q.get(), timeout=2.5)
+        task.cancel()
+
+        stats = await cli.get_stats()
+        self.assertGreater(stats["monitor.filtered"], 0)
+
+        # deadbands are only for numbers
+        with self.assertRaises(grpc.aio.AioRpcError) as cm:
+            await m.monitor(
+                "notify", lambda obj, meta, msg: None, filters=[("admin-status", 1, 0)]
+            )
+        self.assertEqual(cm.exception.code(), grpc.StatusCode.INVALID_ARGUMENT)
+
+        await cli.close()
+
+    async def test_subscribe(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+        q = asyncio.Queue()
+        task = asyncio.create_task(
+            cli.subscribe(
+                [(m, "num-host-interfaces")], lambda msg: q.put_nowait(msg), interval=100
+            )
+        )
+        for _ in range(3):
+            msg = await asyncio.wait_for(q.get(), timeout=5)
+            self.assertEqual(msg.oid, m.oid)
+            self.assertEqual(msg.attrs[0].value, "2")
+        task.cancel()
+
+        hostif = m.get_hostif()
+        await hostif.set("fec-type", "none")
+        q = asyncio.Queue()
+        task = asyncio.create_task(
+            cli.subscribe(
+                [(hostif, "fec-type")],
+                lambda msg: q.put_nowait(msg),
+                on_change=True,
+                interval=100,
+            )
+        )
+        msg = await asyncio.wait_for(q.get(), timeout=5)
+        self.assertEqual(msg.attrs[0].value, "none")
+        await asyncio.sleep(0.5)
+        self.assertTrue(q.empty())
+        await hostif.set("fec-type", "rs")
+        msg = await asyncio.wait_for(q.get(), timeout=5)
+        self.assertEqual(msg.attrs[0].value, "rs")
+        task.cancel()
+
+        # the stream ends when the sampled object is removed
+        netif = m.get_netif()
+        q = asyncio.Queue()
+        task = asyncio.create_task(
+            cli.subscribe(
+                [(netif, "tx-dis")], lambda msg: q.put_nowait(msg), interval=100
+            )
+        )
+        await asyncio.wait_for(q.get(), timeout=5)
+        await cli.remove(netif.oid)
+        with self.assertRaises(grpc.aio.AioRpcError) as cm:
+            await asyncio.wait_for(task, timeout=5)
+        self.assertEqual(cm.exception.code(), grpc.StatusCode.UNKNOWN)
+        self.assertEqual(cm.exception.details(), "object is removed")
+        await m.create_netif(index=0)
+
+        await cli.close()
+
 
 class TestTAIWithConfig(unittest.IsolatedAsyncioTestCase):
     def setUp(self):
@@ -445,6 +839,103 @@ class TestTAIWithConfig(unittest.IsolatedAsyncioTestCase):
 
         await cli.close()
 
+    async def test_typed_custom_list_attribute_module(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+
+        await m.set("custom-list", "1,2,3,4")
+        self.assertEqual(await m.get("custom-list", typed=True), [1, 2, 3, 4])
+
+        await m.set("custom-list", "")
+        self.assertEqual(await m.get("custom-list", typed=True), [])
+
+        await cli.close()
+
+    async def test_cache(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+
+        before = await cli.get_stats()
+        self.assertEqual(await m.get("num-host-interfaces"), "2")
+        self.assertEqual(await m.get("num-host-interfaces"), "2")
+        v = await cli.bulk_get([(m, ["num-host-interfaces"])])
+        self.assertEqual(v[0][0], "2")
+        after = await cli.get_stats()
+        self.assertEqual(after["cache.hits"] - before["cache.hits"], 2)
+
+        # set invalidates the cached value
+        netif = m.get_netif()
+        await netif.set("output-power", "-4")
+        self.assertEqual(round(float(await netif.get("output-power"))), -4)
+        await netif.set("output-power", "-5")
+        self.assertEqual(round(float(await netif.get("output-power"))), -5)
+        self.assertGreater((await cli.get_stats())["cache.invalidations"], 0)
+
+        # every RPC and adapter call is timed
+        hs = await cli.get_histograms()
+        h = next(
+            h for h in hs if h.name == "rpc_latency_us" and h.label == "GetAttribute"
+        )
+        self.assertGreater(h.count, 0)
+        self.assertEqual(sum(h.counts), h.count)
+        self.assertTrue(
+            any(h.name == "adapter_latency_us" and h.label == "set" for h in hs)
+        )
+
+        await cli.close()
+
+    async def test_admission(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+        # the module budget is 100 calls per second
+        v = await asyncio.gather(
+            *[m.get("admin-status") for _ in range(300)], return_exceptions=True
+        )
+        rejected = [e for e in v if isinstance(e, Exception)]
+        self.assertGreater(len(rejected), 0)
+        self.assertLess(len(rejected), 300)
+        for e in rejected:
+            self.assertEqual(e.code(), grpc.StatusCode.RESOURCE_EXHAUSTED)
+        stats = await cli.get_stats()
+        self.assertEqual(stats["admission.rejected_module"], len(rejected))
+        self.assertEqual(stats["admission.rejected_peer"], 0)
+        await cli.close()
+
+    async def test_admission_multiple_modules(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        # the modules are admitted in the order of their oids. empty the budget of the last one
+        modules = sorted((await cli.list()).values(), key=lambda m: m.oid)
+        self.assertGreater(len(modules), 1)
+        first, last = modules[0], modules[-1]
+        await asyncio.gather(
+            *[last.get("admin-status") for _ in range(300)], return_exceptions=True
+        )
+
+        # the calls rejected by the last module don't spend the budget of the first one
+        v = await asyncio.gather(
+            *[
+                cli.bulk_get([(first, ["admin-status"]), (last, ["admin-status"])])
+                for _ in range(100)
+            ],
+            return_exceptions=True,
+        )
+        admitted = len([r for r in v if not isinstance(r, Exception)])
+        self.assertLess(admitted, 100)
+        v = await asyncio.gather(
+            *[first.get("admin-status") for _ in range(100 - admitted)],
+            return_exceptions=True,
+        )
+        self.assertFalse(any(isinstance(e, Exception) for e in v))
+        await cli.close()
+
     async def test_set_custom_list_attribute_module_taish(self):
 
         cli = taish.AsyncClient(
@@ -533,6 +1024,49 @@ class TestTAIWithoutObjectCreation(unittest.IsolatedAsyncioTestCase):
         self.assertNotEqual(output.stdout.decode(), "")
         self.assertEqual(output.stderr.decode(), "")
 
+    async def test_provision(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        v = await cli.provision(
+            [
+                (
+                    None,
+                    [
+                        ("create", "module", [("location", TAI_TEST_MODULE_LOCATION)]),
+                        ("create", "hostif", [("index", 0)]),
+                        ("set", None, [("fec-type", "rs")]),
+                        ("create", "netif", [("index", 0)]),
+                        ("set", None, [("output-power", -4)]),
+                        ("set", None, [("no-such-attribute", 1)]),
+                        ("remove", None),
+                    ],
+                )
+            ]
+        )
+        self.assertEqual(len(v), 1)
+        self.assertEqual(len(v[0]), 7)
+        for oid in v[0][:5]:
+            self.assertIsInstance(oid, int)
+        self.assertIsInstance(v[0][5], taish.TAIException)
+        self.assertIsInstance(v[0][6], taish.TAIException)
+        self.assertEqual(v[0][6].msg, "not-executed")
+
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+        self.assertEqual(m.oid, v[0][0])
+        self.assertEqual(await m.get_hostif().get("fec-type"), "rs")
+        self.assertEqual(round(float(await m.get_netif().get("output-power"))), -4)
+
+        netif = m.get_netif()
+        hostif = m.get_hostif()
+        v = await cli.provision(
+            [(m, [("remove", netif), ("remove", hostif), ("remove", None)])]
+        )
+        self.assertEqual(v[0], [netif.oid, hostif.oid, m.oid])
+        m = await cli.list()
+        self.assertEqual(m[TAI_TEST_MODULE_LOCATION].oid, 0)
+        await cli.close()
+
     def tearDown(self):
         if TAI_TEST_NO_LOCAL_TAISH_SERVER:
             return
@@ -542,5 +1076,432 @@ class TestTAIWithoutObjectCreation(unittest.IsolatedAsyncioTestCase):
         self.proc.stdout.close()
 
 
+class TestTAIUnixSocket(unittest.IsolatedAsyncioTestCase):
+    def setUp(self):
+        if TAI_TEST_NO_LOCAL_TAISH_SERVER:
+            self.skipTest("no local taish server")
+        proc = sp.Popen(
+            ["taish_server", "-n", "-u", TAI_TEST_TAISH_SERVER_UNIX_PATH],
+            stderr=sp.STDOUT,
+            stdout=sp.PIPE,
+        )
+        self.d = threading.Thread(target=output_reader, args=(proc,))
+        self.d.start()
+        self.proc = proc
+        time.sleep(5)  # wait for the server to be ready
+
+    async def test_list_unix(self):
+        cli = taish.AsyncClient(f"unix:{TAI_TEST_TAISH_SERVER_UNIX_PATH}")
+        m = await cli.list()
+        self.assertTrue(TAI_TEST_MODULE_LOCATION in m)
+
+        await cli.close()
+
+    def tearDown(self):
+        self.proc.terminate()
+        self.proc.wait(timeout=1)
+        self.d.join()
+        self.proc.stdout.close()
+
+
+class TestTAIRecord(unittest.IsolatedAsyncioTestCase):
+    def setUp(self):
+        if TAI_TEST_NO_LOCAL_TAISH_SERVER:
+            self.skipTest("needs the record file of a local taish_server")
+        proc = sp.Popen(
+            ["taish_server", "-n", "-R", TAI_TEST_TAISH_SERVER_RECORD_PATH],
+            stderr=sp.STDOUT,
+            stdout=sp.PIPE,
+        )
+        self.d = threading.Thread(target=output_reader, args=(proc,))
+        self.d.start()
+        self.proc = proc
+        time.sleep(5)  # wait for the server to be ready
+
+    async def test_record(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        await cli.list()
+        stats = await cli.get_stats()
+        # ListModule and GetStats
+        self.assertGreaterEqual(stats["record.calls"], 2)
+        with open(TAI_TEST_TAISH_SERVER_RECORD_PATH, "rb") as f:
+            self.assertEqual(f.read(8), b"TAIREC1\0")
+
+        await cli.close()
+
+    def tearDown(self):
+        self.proc.terminate()
+        self.proc.wait(timeout=1)
+        self.d.join()
+        self.proc.stdout.close()
+
+
+class TestTAIConfigReload(unittest.IsolatedAsyncioTestCase):
+    def write_config(self, module, hostif, netif):
+        config = {
+            TAI_TEST_MODULE_LOCATION: {
+                "attrs": module,
+                "hostif": {"0": {"attrs": hostif}},
+                "netif": {"0": {"attrs": netif}},
+            },
+            "taish": {"cache": {"netif": {"output-power": 60000}}},
+        }
+        with open(TAI_TEST_TAISH_SERVER_RELOAD_CONFIG_PATH, "w") as f:
+            json.dump(config, f)
+
+    def setUp(self):
+        if TAI_TEST_NO_LOCAL_TAISH_SERVER:
+            self.skipTest("needs a local taish_server to send SIGHUP to")
+        self.write_config({"admin-status": "down"}, {}, {"output-power": -4})
+        proc = sp.Popen(
+            ["taish_server", "-f", TAI_TEST_TAISH_SERVER_RELOAD_CONFIG_PATH],
+            stderr=sp.STDOUT,
+            stdout=sp.PIPE,
+        )
+        self.d = threading.Thread(target=output_reader, args=(proc,))
+        self.d.start()
+        self.proc = proc
+        time.sleep(5)  # wait for the server to be ready
+
+    async def test_reload(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+        netif = m.get_netif()
+        hostif = m.get_hostif()
+        self.assertEqual(await m.get("admin-status"), "down")
+        self.assertEqual(round(float(await netif.get("output-power"))), -4)
+
+        self.write_config(
+            {"admin-status": "up"}, {"fec-type": "rs"}, {"output-power": -5}
+        )
+        self.proc.send_signal(signal.SIGHUP)
+        await asyncio.sleep(1)
+
+        self.assertEqual(await m.get("admin-status"), "up")
+        self.assertEqual(await hostif.get("fec-type"), "rs")
+        # the cached value is invalidated by the reload
+        self.assertEqual(round(float(await netif.get("output-power"))), -5)
+
+        # a broken config is not applied and the server keeps running
+        with open(TAI_TEST_TAISH_SERVER_RELOAD_CONFIG_PATH, "w") as f:
+            f.write("{")
+        self.proc.send_signal(signal.SIGHUP)
+        await asyncio.sleep(1)
+        self.assertEqual(await m.get("admin-status"), "up")
+
+        # the attributes removed from the config are left as they are
+        self.write_config({}, {"fec-type": "rs"}, {"output-power": -5})
+        self.proc.send_signal(signal.SIGHUP)
+        await asyncio.sleep(1)
+        self.assertEqual(await m.get("admin-status"), "up")
+
+        await cli.close()
+
+    def tearDown(self):
+        self.proc.terminate()
+        self.proc.wait(timeout=1)
+        self.d.join()
+        self.proc.stdout.close()
+        os.remove(TAI_TEST_TAISH_SERVER_RELOAD_CONFIG_PATH)
+
+
+class TestTAIConfigCache(unittest.IsolatedAsyncioTestCase):
+    def start(self):
+        self.lines = []
+        proc = sp.Popen(
+            [
+                "taish_server",
+                "-f",
+                "config.json",
+                "-C",
+                TAI_TEST_TAISH_SERVER_CONFIG_CACHE_PATH,
+            ],
+            stderr=sp.STDOUT,
+            stdout=sp.PIPE,
+        )
+        self.d = threading.Thread(target=output_reader, args=(proc, self.lines))
+        self.d.start()
+        self.proc = proc
+
+    def stop(self):
+        self.proc.terminate()
+        self.proc.wait(timeout=1)
+        self.d.join()
+        self.proc.stdout.close()
+
+    def setUp(self):
+        if TAI_TEST_NO_LOCAL_TAISH_SERVER:
+            self.skipTest("needs a local taish_server to restart")
+        if os.path.exists(TAI_TEST_TAISH_SERVER_CONFIG_CACHE_PATH):
+            os.remove(TAI_TEST_TAISH_SERVER_CONFIG_CACHE_PATH)
+        self.start()
+        time.sleep(5)  # wait for the server to be ready
+
+    async def assert_config_applied(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+        self.assertEqual(await m.get("admin-status"), "down")
+        self.assertEqual(await m.get("custom"), "true")
+        await cli.close()
+
+    async def test_config_cache(self):
+        self.assertTrue(any(l.startswith("compiling the config") for l in self.lines))
+        self.assertTrue(os.path.exists(TAI_TEST_TAISH_SERVER_CONFIG_CACHE_PATH))
+        await self.assert_config_applied()
+
+        # a warm start reads the compiled config
+        self.stop()
+        self.start()
+        await asyncio.sleep(5)
+        self.assertTrue(any(l.startswith("read the config of") for l in self.lines))
+        self.assertTrue(any("config: cached" in l for l in self.lines))
+        await self.assert_config_applied()
+
+        # a broken cache is compiled again
+        with open(TAI_TEST_TAISH_SERVER_CONFIG_CACHE_PATH, "wb") as f:
+            f.write(b"TAICFG1\0\xff")
+        self.stop()
+        self.start()
+        await asyncio.sleep(5)
+        self.assertTrue(any(l.startswith("compiling the config") for l in self.lines))
+        await self.assert_config_applied()
+
+    def tearDown(self):
+        self.stop()
+        os.remove(TAI_TEST_TAISH_SERVER_CONFIG_CACHE_PATH)
+
+
+class TestTAIWarmRestart(unittest.IsolatedAsyncioTestCase):
+    def start(self):
+        self.lines = []
+        proc = sp.Popen(
+            [
+                "taish_server",
+                "-f",
+                "config.json",
+                "-J",
+                TAI_TEST_TAISH_SERVER_JOURNAL_PATH,
+            ],
+            stderr=sp.STDOUT,
+            stdout=sp.PIPE,
+        )
+        self.d = threading.Thread(target=output_reader, args=(proc, self.lines))
+        self.d.start()
+        self.proc = proc
+
+    def stop(self):
+        self.proc.terminate()
+        self.proc.wait(timeout=1)
+        self.d.join()
+        self.proc.stdout.close()
+
+    def setUp(self):
+        if TAI_TEST_NO_LOCAL_TAISH_SERVER:
+            self.skipTest("needs a local taish_server to restart")
+        if os.path.exists(TAI_TEST_TAISH_SERVER_JOURNAL_PATH):
+            os.remove(TAI_TEST_TAISH_SERVER_JOURNAL_PATH)
+        self.start()
+        time.sleep(5)  # wait for the server to be ready
+
+    async def get_oids(self):
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.get_module(TAI_TEST_MODULE_LOCATION)
+        self.assertEqual(await m.get("admin-status"), "down")
+        self.assertEqual(await m.get("custom"), "true")
+        oids = (m.oid, m.get_netif().oid, m.get_hostif().oid)
+        await cli.close()
+        return oids
+
+    async def test_warm_restart(self):
+        self.assertFalse(any(l.startswith("warm restart") for l in self.lines))
+        oids = await self.get_oids()
+
+        # the bring-up is journaled once it is done, without the oper-status
+        with open(TAI_TEST_TAISH_SERVER_JOURNAL_PATH) as f:
+            journal = json.load(f)
+        module = journal["modules"][TAI_TEST_MODULE_LOCATION]
+        self.assertEqual(module["oid"], oids[0])
+        self.assertNotIn("oper-status", module)
+
+        # the modules are left running and journaled
+        self.stop()
+        self.assertTrue(
+            any(l.startswith("left the modules running") for l in self.lines)
+        )
+        with open(TAI_TEST_TAISH_SERVER_JOURNAL_PATH) as f:
+            journal = json.load(f)
+        module = journal["modules"][TAI_TEST_MODULE_LOCATION]
+        self.assertEqual(module["oid"], oids[0])
+        self.assertIn("oper-status", module)
+
+        # a module which isn't in the journal is initialized as on a cold start
+        cold = next(l for l in journal["modules"] if l != TAI_TEST_MODULE_LOCATION)
+        cold_oid = journal["modules"].pop(cold)["oid"]
+        with open(TAI_TEST_TAISH_SERVER_JOURNAL_PATH, "w") as f:
+            json.dump(journal, f)
+
+        # the next start reattaches to them
+        self.start()
+        await asyncio.sleep(5)
+        self.assertTrue(any(l.startswith("warm restart") for l in self.lines))
+        self.assertTrue(
+            any(
+                l.startswith(f"reattached module {TAI_TEST_MODULE_LOCATION} ")
+                for l in self.lines
+            )
+        )
+        self.assertFalse(
+            any(l.startswith(f"reattached module {cold} ") for l in self.lines)
+        )
+        self.assertTrue(
+            any(
+                f"reattaching to the module at {TAI_TEST_MODULE_LOCATION}\n" in l
+                for l in self.lines
+            )
+        )
+        self.assertFalse(
+            any(f"reattaching to the module at {cold}\n" in l for l in self.lines)
+        )
+        self.assertEqual(await self.get_oids(), oids)
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.get_module(cold)
+        self.assertEqual(m.oid, cold_oid)
+        await cli.close()
+
+        # a broken journal makes a cold start
+        self.stop()
+        with open(TAI_TEST_TAISH_SERVER_JOURNAL_PATH, "w") as f:
+            f.write("{")
+        self.start()
+        await asyncio.sleep(5)
+        self.assertTrue(
+            any(l.startswith("ignoring the broken journal") for l in self.lines)
+        )
+        self.assertFalse(any(l.startswith("reattached module") for l in self.lines))
+        self.assertEqual(await self.get_oids(), oids)
+
+    def tearDown(self):
+        self.stop()
+        os.remove(TAI_TEST_TAISH_SERVER_JOURNAL_PATH)
+
+
+class TestTAIPresenceDebounce(unittest.IsolatedAsyncioTestCase):
+    def start(self, interval=None):
+        if TAI_TEST_NO_LOCAL_TAISH_SERVER:
+            self.skipTest("needs the output of a local taish_server")
+        self.lines = []
+        env = dict(os.environ)
+        if interval is not None:
+            # the basic adapter announces the modules this many milliseconds apart
+            env["TAI_BASIC_PRESENCE_INTERVAL_MS"] = str(interval)
+        proc = sp.Popen("taish_server", stderr=sp.STDOUT, stdout=sp.PIPE, env=env)
+        self.d = threading.Thread(target=output_reader, args=(proc, self.lines))
+        self.d.start()
+        self.proc = proc
+        time.sleep(5)  # wait for the server to be ready
+
+    def passes(self):
+        return [
+            l for l in self.lines if l.startswith("brought up") and "modules in" in l
+        ]
+
+    async def test_presence_debounce(self):
+        self.start()
+        # the modules which appear at startup are brought up in one pass
+        passes = self.passes()
+        self.assertEqual(len(passes), 1)
+
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.list()
+        self.assertTrue(passes[0].startswith("brought up {} modules".format(len(m))))
+        await cli.close()
+
+    async def test_presence_burst(self):
+        # the modules appear one by one within the debounce window of 50ms
+        self.start(2)
+        passes = self.passes()
+        self.assertEqual(len(passes), 1)
+
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.list()
+        self.assertTrue(passes[0].startswith("brought up {} modules".format(len(m))))
+        await cli.close()
+
+    async def test_presence_spread(self):
+        # the modules which appear further apart than the window are brought up one by one
+        self.start(200)
+        cli = taish.AsyncClient(
+            TAI_TEST_TAISH_SERVER_ADDRESS, TAI_TEST_TAISH_SERVER_PORT
+        )
+        m = await cli.list()
+        passes = self.passes()
+        self.assertEqual(len(passes), len(m))
+        self.assertTrue(all(l.startswith("brought up 1 modules") for l in passes))
+        await cli.close()
+
+    def tearDown(self):
+        if not hasattr(self, "proc"):
+            return
+        self.proc.terminate()
+        self.proc.wait(timeout=1)
+        self.d.join()
+        self.proc.stdout.close()
+
+
+class TestTAIAsync(TestTAI):
+    def setUp(self):
+        if TAI_TEST_NO_LOCAL_TAISH_SERVER:
+            return
+        proc = sp.Popen(
+            ["taish_server", "-a", "-P", "2", "-W", "2"],
+            stderr=sp.STDOUT,
+            stdout=sp.PIPE,
+            env=gate_env(),
+        )
+        self.d = threading.Thread(target=output_reader, args=(proc,))
+        self.d.start()
+        self.proc = proc
+        time.sleep(5)  # wait for the server to be ready
+
+    async def test_get_coalesced(self):
+        # the removal and the get which reads take both workers, so no get is left to join it.
+        # TestTAIPerModuleLock covers the async server
+        self.skipTest("needs more than 2 workers")
+
+    async def test_priority_order(self):
+        # the get and the set queue up in the worker pool in the arrival order
+        self.skipTest("needs more than 2 workers")
+
+
+class TestTAIPerModuleLock(TestTAI):
+    def setUp(self):
+        if TAI_TEST_NO_LOCAL_TAISH_SERVER:
+            return
+        proc = sp.Popen(
+            ["taish_server", "-a", "-W", "4", "-m"],
+            stderr=sp.STDOUT,
+            stdout=sp.PIPE,
+            env=gate_env(),
+        )
+        self.d = threading.Thread(target=output_reader, args=(proc,))
+        self.d.start()
+        self.proc = proc
+        time.sleep(5)  # wait for the server to be ready
+
+
 if __name__ == "__main__":
     unittest.main()
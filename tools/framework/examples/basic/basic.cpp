@@ -2,6 +2,11 @@
 #include "logger.hpp"
 
 #include <sys/timerfd.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
 
 namespace tai::basic {
 
@@ -19,9 +24,41 @@ namespace tai::basic {
         return "unknown";
     }
 
+    void pass_gate() {
+        auto path = std::getenv("TAI_BASIC_GATE");
+        if ( path == nullptr ) {
+            return;
+        }
+        // opening a FIFO for reading waits for its writer, and the read for the byte it writes
+        auto fd = open(path, O_RDONLY | O_CLOEXEC);
+        if ( fd < 0 ) {
+            TAI_WARN("failed to open the gate %s: %s", path, strerror(errno));
+            return;
+        }
+        char c;
+        while ( read(fd, &c, 1) < 0 && errno == EINTR );
+        close(fd);
+    }
+
     Platform::Platform(const tai_service_method_table_t * services) : tai::framework::Platform(services) {
 
         if ( services != nullptr && services->module_presence != nullptr ) {
+            // TAI_BASIC_PRESENCE_INTERVAL_MS spreads the presence of the modules over time,
+            // as the modules of a real chassis appear, so that the adapter host can be tested with it
+            auto interval = std::getenv("TAI_BASIC_PRESENCE_INTERVAL_MS");
+            if ( interval != nullptr && std::atoi(interval) > 0 ) {
+                auto ms = std::chrono::milliseconds(std::atoi(interval));
+                auto presence = services->module_presence;
+                m_presence = std::thread([presence, ms]() {
+                    for ( auto i = 0; i < BASIC_NUM_MODULE; i++ ) {
+                        if ( i > 0 ) {
+                            std::this_thread::sleep_for(ms);
+                        }
+                        presence(true, const_cast<char*>(std::to_string(i).c_str()));
+                    }
+                });
+                return;
+            }
             for ( auto i = 0; i < BASIC_NUM_MODULE; i++ ) {
                 services->module_presence(true, const_cast<char*>(std::to_string(i).c_str()));
             }
@@ -29,6 +66,9 @@ namespace tai::basic {
     }
 
     Platform::~Platform() {
+        if ( m_presence.joinable() ) {
+            m_presence.join();
+        }
         std::vector<tai_object_id_t> oids;
         for ( auto& it : m_objects ) {
             oids.emplace_back(it.first);
@@ -49,16 +89,22 @@ namespace tai::basic {
             case TAI_OBJECT_TYPE_MODULE:
                 {
                     tai::framework::Location loc;
+                    // only the modules the adapter host created again on a warm restart skip the initialization
+                    auto warm = false;
                     for ( auto i = 0; i < static_cast<int>(count); i++ ) {
                         if ( list[i].id == TAI_MODULE_ATTR_LOCATION ) {
                             loc = tai::framework::Location(list[i].value.charlist.list, list[i].value.charlist.count);
-                            break;
+                        } else if ( list[i].id == TAI_MODULE_ATTR_WARM_RESTART ) {
+                            warm = warm_restart() && list[i].value.booldata;
                         }
                     }
                     if ( loc == "" ) {
                         return TAI_STATUS_MANDATORY_ATTRIBUTE_MISSING;
                     }
-                    auto fsm = std::make_shared<FSM>(loc);
+                    if ( warm ) {
+                        TAI_INFO("reattaching to the module at %s", loc.c_str());
+                    }
+                    auto fsm = std::make_shared<FSM>(loc, warm);
                     auto it = m_fsms.find(loc);
                     if ( it != m_fsms.end() ) {
                         return TAI_STATUS_ITEM_ALREADY_EXISTS;
@@ -233,6 +279,12 @@ namespace tai::basic {
             return -1;
         }
         m_netif = netif;
+        // on a warm restart the hardware is already initialized and configured.
+        // go back to READY as soon as the objects are reattached instead of
+        // waiting for the periodic configured() check
+        if ( m_warm_restart && configured() ) {
+            transit(FSM_STATE_READY);
+        }
         return 0;
     }
 
@@ -383,7 +435,8 @@ namespace tai::basic {
     // The callback for FSM_STATE_INIT
     //
     // In this example, just go to the next state (WAITING_CONFIGURATION)
-    // We can do some initialization in real scenario
+    // We can do some initialization in real scenario, which a warm restart
+    // (m_warm_restart) must skip since the hardware is already initialized
     FSMState FSM::_init_cb(FSMState current, void* user) {
         return FSM_STATE_WAITING_CONFIGURATION;
     }
@@ -554,6 +607,7 @@ namespace tai::basic {
         basic::M(TAI_MODULE_ATTR_MODULE_SHUTDOWN_REQUEST_NOTIFY),
         basic::M(TAI_MODULE_ATTR_MODULE_STATE_CHANGE_NOTIFY),
         basic::M(TAI_MODULE_ATTR_NOTIFY),
+        basic::M(TAI_MODULE_ATTR_WARM_RESTART),
     };
 
     tai_status_t netif_tx_dis_setter(const tai_attribute_t* const attribute, FSMState* state, void* user) {
@@ -3,6 +3,7 @@
 
 #include "platform.hpp"
 #include <atomic>
+#include <thread>
 
 namespace tai::basic {
 
@@ -15,6 +16,9 @@ namespace tai::basic {
     // the same object ID format as examples/stub is used
     const uint8_t OBJECT_TYPE_SHIFT = 48;
 
+    // blocks until a byte is written to the FIFO named by TAI_BASIC_GATE, when it is set
+    void pass_gate();
+
     class Platform : public tai::framework::Platform {
         public:
             Platform(const tai_service_method_table_t * services);
@@ -23,6 +27,9 @@ namespace tai::basic {
             tai_status_t remove(tai_object_id_t id);
             tai_object_type_t get_object_type(tai_object_id_t id);
             tai_object_id_t   get_module_id(tai_object_id_t id);
+        private:
+            // announces the modules one by one when TAI_BASIC_PRESENCE_INTERVAL_MS is set
+            std::thread m_presence;
     };
 
     class Module;
@@ -73,7 +80,8 @@ namespace tai::basic {
 
         // methods/fields specific to this example
         public:
-            FSM(Location loc) : m_loc(loc), m_module(nullptr), m_netif(nullptr), m_hostif{}, m_no_transit(false) {}
+            // warm_restart: the module kept running while the adapter host restarted. see TAI_MODULE_ATTR_WARM_RESTART
+            FSM(Location loc, bool warm_restart = false) : m_loc(loc), m_module(nullptr), m_netif(nullptr), m_hostif{}, m_no_transit(false), m_warm_restart(warm_restart) {}
             int set_module(S_Module module);
             int set_netif(S_NetIf   netif);
             int set_hostif(S_HostIf hostif, int index);
@@ -103,6 +111,7 @@ namespace tai::basic {
             S_NetIf m_netif;
             S_HostIf m_hostif[BASIC_NUM_HOSTIF];
             std::atomic<bool> m_no_transit;
+            bool m_warm_restart;
     };
 
     using S_FSM = std::shared_ptr<FSM>;
@@ -131,6 +140,10 @@ namespace tai::basic {
                         TAI_ERROR("no metadata for attribute 0x%x", attribute->id);
                         return info[i].status;
                     }
+                    // setting TAI_MODULE_ATTR_CUSTOM lets a test hold the module until it opens the gate
+                    if ( T == TAI_OBJECT_TYPE_MODULE && attribute->id == TAI_MODULE_ATTR_CUSTOM ) {
+                        pass_gate();
+                    }
                     auto ret = tai::framework::Object<T>::config().direct_set(std::make_shared<Attribute>(meta, *attribute));
                     if ( ret != TAI_STATUS_SUCCESS ) {
                         return convert_tai_error_to_list(ret, info[i].index);
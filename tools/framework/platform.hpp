@@ -28,6 +28,16 @@ namespace tai::framework {
                 return nullptr;
             }
 
+            // the flags given to tai_api_initialize()
+            void set_flags(uint64_t flags) {
+                m_flags = flags;
+            }
+
+            // the hardware kept running while the adapter host restarted. see TAI_API_INITIALIZE_FLAG_WARM_RESTART
+            bool warm_restart() const {
+                return (m_flags & TAI_API_INITIALIZE_FLAG_WARM_RESTART) != 0;
+            }
+
             virtual tai_object_type_t get_object_type(tai_object_id_t id) = 0;
             virtual tai_object_id_t get_module_id(tai_object_id_t id) = 0;
 
@@ -69,6 +79,7 @@ namespace tai::framework {
 
         protected:
             const tai_service_method_table_t * m_services;
+            uint64_t m_flags = 0;
             // we don't need a lock to access m_objects/m_fsms since TAI API is not thread-safe
             std::map<tai_object_id_t, S_BaseObject> m_objects;
             std::map<Location, S_FSM> m_fsms;
@@ -420,6 +420,7 @@ tai_status_t tai_api_initialize(uint64_t flags, const tai_service_method_table_t
     }
     try {
         g_platform.reset(new ::Platform(services));
+        g_platform->set_flags(flags);
     } catch ( tai::Exception& e ) {
         return e.err();
     }
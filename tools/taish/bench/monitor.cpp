@@ -0,0 +1,221 @@
+/**
+ * @file    monitor.cpp
+ *
+ * @brief   This module measures how taish server scales with concurrent Monitor streams
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ * For each number of streams, it opens the Monitor streams on the module
+ * notify attribute and then issues GetAttribute calls from a set of clients
+ * for the given duration. The unary throughput/latency and the number of
+ * delivered notifications are reported.
+ *
+ * $ ./taish_server -a -P 2 -W 4 &
+ * $ ./bench/taish_bench_monitor -s 0,16,64,256 -c 4 -d 5
+ */
+
+#include <grpc++/grpc++.h>
+#include "taish.grpc.pb.h"
+
+#include <unistd.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+using namespace std::chrono;
+
+// TAI_MODULE_ATTR_NOTIFY and TAI_MODULE_ATTR_NUM_HOST_INTERFACES are resolved by name
+// so that the benchmark doesn't depend on the TAI headers
+static uint64_t resolve(taish::TAI::Stub* stub, const std::string& name) {
+    grpc::ClientContext ctx;
+    taish::GetAttributeMetadataRequest req;
+    taish::GetAttributeMetadataResponse res;
+    req.set_object_type(taish::MODULE);
+    req.set_attr_name(name);
+    req.mutable_serialize_option()->set_human(true);
+    auto s = stub->GetAttributeMetadata(&ctx, req, &res);
+    if ( !s.ok() ) {
+        throw std::runtime_error("failed to resolve " + name + ": " + s.error_message());
+    }
+    return res.metadata().attr_id();
+}
+
+static uint64_t find_module(taish::TAI::Stub* stub, const std::string& location) {
+    grpc::ClientContext ctx;
+    taish::ListModuleRequest req;
+    taish::ListModuleResponse res;
+    auto reader = stub->ListModule(&ctx, req);
+    uint64_t oid = 0;
+    while ( reader->Read(&res) ) {
+        if ( res.module().location() == location ) {
+            oid = res.module().oid();
+        }
+    }
+    reader->Finish();
+    return oid;
+}
+
+struct result_t {
+    int streams;
+    uint64_t calls;
+    uint64_t errors;
+    uint64_t notifications;
+    double rps;
+    double p50;
+    double p99;
+};
+
+static result_t run(std::shared_ptr<grpc::Channel> channel, uint64_t oid, uint64_t notify_id, uint64_t attr_id, int streams, int clients, int duration, bool typed) {
+    std::atomic<uint64_t> notifications(0);
+    std::vector<std::unique_ptr<grpc::ClientContext>> ctxs;
+    std::vector<std::thread> monitors;
+
+    for ( int i = 0; i < streams; i++ ) {
+        ctxs.emplace_back(new grpc::ClientContext());
+        auto ctx = ctxs.back().get();
+        monitors.emplace_back([&, ctx]() {
+            auto stub = taish::TAI::NewStub(channel);
+            taish::MonitorRequest req;
+            taish::MonitorResponse res;
+            req.set_oid(oid);
+            req.set_notification_attr_id(notify_id);
+            req.mutable_serialize_option()->set_human(true);
+            req.mutable_serialize_option()->set_value_only(true);
+            req.mutable_serialize_option()->set_typed(typed);
+            auto reader = stub->Monitor(ctx, req);
+            while ( reader->Read(&res) ) {
+                notifications++;
+            }
+            reader->Finish();
+        });
+    }
+
+    // give the streams time to subscribe before measuring
+    std::this_thread::sleep_for(milliseconds(500 + streams * 2));
+    notifications = 0;
+
+    std::vector<std::vector<double>> latencies(clients);
+    std::atomic<uint64_t> errors(0);
+    std::vector<std::thread> callers;
+    auto end = steady_clock::now() + seconds(duration);
+
+    for ( int i = 0; i < clients; i++ ) {
+        callers.emplace_back([&, i]() {
+            auto stub = taish::TAI::NewStub(channel);
+            taish::GetAttributeRequest req;
+            req.set_oid(oid);
+            req.mutable_serialize_option()->set_human(true);
+            req.mutable_serialize_option()->set_value_only(true);
+            req.mutable_serialize_option()->set_typed(typed);
+            req.add_attributes()->set_attr_id(attr_id);
+            while ( steady_clock::now() < end ) {
+                grpc::ClientContext ctx;
+                taish::GetAttributeResponse res;
+                auto start = steady_clock::now();
+                auto s = stub->GetAttribute(&ctx, req, &res);
+                auto d = duration_cast<microseconds>(steady_clock::now() - start).count();
+                if ( !s.ok() ) {
+                    errors++;
+                    continue;
+                }
+                latencies[i].push_back(d);
+            }
+        });
+    }
+
+    for ( auto& t : callers ) {
+        t.join();
+    }
+    uint64_t received = notifications;
+
+    for ( auto& c : ctxs ) {
+        c->TryCancel();
+    }
+    for ( auto& t : monitors ) {
+        t.join();
+    }
+
+    std::vector<double> all;
+    for ( auto& l : latencies ) {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    std::sort(all.begin(), all.end());
+    result_t r{.streams = streams, .calls = all.size(), .errors = errors, .notifications = received};
+    r.rps = static_cast<double>(all.size()) / duration;
+    r.p50 = all.size() > 0 ? all[all.size() / 2] : 0;
+    r.p99 = all.size() > 0 ? all[std::min(all.size() - 1, all.size() * 99 / 100)] : 0;
+    return r;
+}
+
+int main(int argc, char *argv[]) {
+    std::string addr = "localhost:50051";
+    std::string location = "0";
+    std::string streams = "0,16,64,256";
+    int clients = 4;
+    int duration = 5;
+    bool typed = false;
+    int c;
+
+    while ((c = getopt (argc, argv, "a:l:s:c:d:t")) != -1) {
+        switch (c) {
+        case 'a':
+            addr = std::string(optarg);
+            break;
+        case 'l':
+            location = std::string(optarg);
+            break;
+        case 's':
+            streams = std::string(optarg);
+            break;
+        case 'c':
+            clients = atoi(optarg);
+            break;
+        case 'd':
+            duration = atoi(optarg);
+            break;
+        case 't':
+            typed = true;
+            break;
+        default:
+            std::cerr << "usage: " << argv[0] << " -a <server address> -l <module location> -s <comma separated number of streams> -c <number of unary clients> -d <duration in seconds> -t (use typed values)" << std::endl;
+            return 1;
+        }
+    }
+
+    auto channel = grpc::CreateChannel(addr, grpc::InsecureChannelCredentials());
+    auto stub = taish::TAI::NewStub(channel);
+
+    uint64_t oid, notify_id, attr_id;
+    try {
+        oid = find_module(stub.get(), location);
+        notify_id = resolve(stub.get(), "notify");
+        attr_id = resolve(stub.get(), "num-host-interfaces");
+    } catch ( std::runtime_error& e ) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    if ( oid == 0 ) {
+        std::cerr << "module " << location << " not found" << std::endl;
+        return 1;
+    }
+
+    std::cout << std::setw(8) << "streams" << std::setw(12) << "calls/s" << std::setw(12) << "p50(us)" << std::setw(12) << "p99(us)" << std::setw(10) << "errors" << std::setw(16) << "notifications" << std::endl;
+
+    std::stringstream ss(streams);
+    std::string n;
+    while ( std::getline(ss, n, ',') ) {
+        auto r = run(channel, oid, notify_id, attr_id, std::stoi(n), clients, duration, typed);
+        std::cout << std::setw(8) << r.streams << std::setw(12) << std::fixed << std::setprecision(1) << r.rps << std::setw(12) << r.p50 << std::setw(12) << r.p99 << std::setw(10) << r.errors << std::setw(16) << r.notifications << std::endl;
+    }
+    return 0;
+}
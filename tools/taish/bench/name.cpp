@@ -0,0 +1,134 @@
+/**
+ * @file    name.cpp
+ *
+ * @brief   This module measures the attribute name resolution of taish server
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ * Resolves all module, netif and hostif attribute names the given number of
+ * times with tai_deserialize_enum() and with resolve_attr_name(), and reports
+ * the average time per lookup. It first checks that a name isn't resolved with
+ * an index built from other metadata which had the same address.
+ *
+ * $ LD_LIBRARY_PATH=../../meta ./bench/taish_bench_name -n 1000
+ */
+
+#include "name.hpp"
+
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+using namespace std::chrono;
+
+struct name_t {
+    const tai_enum_metadata_t* meta;
+    std::string name;
+    int32_t id;
+};
+
+static double measure(const std::vector<name_t>& names, int iterations, std::function<int(const name_t&, int32_t*)> resolve) {
+    auto start = steady_clock::now();
+    for ( int i = 0; i < iterations; i++ ) {
+        for ( auto& n : names ) {
+            int32_t id;
+            if ( resolve(n, &id) < 0 || id != n.id ) {
+                throw std::runtime_error("failed to resolve " + n.name);
+            }
+        }
+    }
+    auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    return static_cast<double>(elapsed) / (static_cast<double>(iterations) * names.size());
+}
+
+// the adapter may free location dependent metadata and allocate other metadata at the same address.
+// the module metadata is replaced by a copy whose values and names are in the reverse order.
+// returns false when a name is resolved with the index of the metadata which had the address before
+static bool check_reused_address() {
+    auto module = tai_metadata_all_object_type_infos[TAI_OBJECT_TYPE_MODULE]->enummetadata;
+    std::vector<int> values(module->values, module->values + module->valuescount);
+    std::vector<const char*> names(module->valuesshortnames, module->valuesshortnames + module->valuescount);
+    std::reverse(values.begin(), values.end());
+    std::reverse(names.begin(), names.end());
+    auto v = values.data();
+    auto n = names.data();
+
+    alignas(tai_enum_metadata_t) unsigned char buf[sizeof(tai_enum_metadata_t)];
+    auto meta = reinterpret_cast<const tai_enum_metadata_t*>(buf);
+    tai_serialize_option_t option{.human = true};
+    for ( size_t i = 0; i < module->valuescount; i++ ) {
+        std::string name = module->valuesshortnames[i];
+        int32_t id;
+        memcpy(buf, module, sizeof(buf));
+        if ( resolve_attr_name(meta, name, &id, &option) < 0 ) {
+            return false;
+        }
+        memcpy(buf + offsetof(tai_enum_metadata_t, values), &v, sizeof(v));
+        memcpy(buf + offsetof(tai_enum_metadata_t, valuesshortnames), &n, sizeof(n));
+        if ( resolve_attr_name(meta, name, &id, &option) < 0 || id != module->values[i] ) {
+            std::cerr << "resolved " << name << " with the metadata which had the same address" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = 1000;
+    int c;
+
+    while ((c = getopt (argc, argv, "n:")) != -1) {
+        switch (c) {
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        default:
+            std::cerr << "usage: " << argv[0] << " -n <number of iterations>" << std::endl;
+            return 1;
+        }
+    }
+
+    if ( !check_reused_address() ) {
+        return 1;
+    }
+
+    std::cout << std::setw(8) << "human" << std::setw(8) << "names" << std::setw(16) << "linear(ns)" << std::setw(16) << "index(ns)" << std::endl;
+
+    for ( auto human : {false, true} ) {
+        tai_serialize_option_t option{.human = human};
+        std::vector<name_t> names;
+        for ( auto type : {TAI_OBJECT_TYPE_MODULE, TAI_OBJECT_TYPE_NETWORKIF, TAI_OBJECT_TYPE_HOSTIF} ) {
+            auto meta = tai_metadata_all_object_type_infos[type]->enummetadata;
+            auto list = human ? meta->valuesshortnames : meta->valuesnames;
+            for ( size_t i = 0; i < meta->valuescount; i++ ) {
+                names.emplace_back(name_t{meta, list[i], meta->values[i]});
+            }
+        }
+
+        try {
+            auto linear = measure(names, iterations, [&](const name_t& n, int32_t* id) {
+                return tai_deserialize_enum(n.name.c_str(), n.meta, id, &option);
+            });
+            auto index = measure(names, iterations, [&](const name_t& n, int32_t* id) {
+                return resolve_attr_name(n.meta, n.name, id, &option);
+            });
+            std::cout << std::setw(8) << std::boolalpha << human << std::setw(8) << names.size() << std::setw(16) << std::fixed << std::setprecision(1) << linear << std::setw(16) << index << std::endl;
+        } catch ( std::runtime_error& e ) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
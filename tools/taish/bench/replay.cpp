@@ -0,0 +1,258 @@
+/**
+ * @file    replay.cpp
+ *
+ * @brief   This module replays the RPCs recorded by taish_server -R
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ * Re-issues the recorded requests to a server with the same intervals as
+ * they arrived, divided by the scale (-s 2 replays twice as fast, -s 0 issues
+ * them back to back). At most the given number of calls are in flight. The
+ * requests are sent as recorded, so the object ids in them must be valid on the
+ * target server (e.g. the same TAI adapter and configuration as the recording).
+ * Monitor and Subscribe streams never end by themselves and are skipped.
+ * The throughput and the latency percentiles per method are reported.
+ *
+ * $ ./taish_server -R /tmp/taish.rec &
+ * $ ... run the workload, then restart taish_server without -R ...
+ * $ ./bench/taish_bench_replay -f /tmp/taish.rec -s 1 -c 64
+ */
+
+#include "taigrpc.hpp"
+#include <grpcpp/generic/generic_stub.h>
+
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <map>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std::chrono;
+
+// one replayed call. the tag passed to the completion queue
+struct call_t {
+    enum { START, WRITE, READ, FINISH } state;
+    const tai_recorded_call_t* record;
+    grpc::ClientContext ctx;
+    grpc::ByteBuffer req;
+    grpc::ByteBuffer res;
+    grpc::Status status;
+    std::unique_ptr<grpc::GenericClientAsyncReaderWriter> stream;
+    steady_clock::time_point start;
+};
+
+struct method_stats_t {
+    std::vector<double> latencies; // us
+    uint64_t errors = 0;
+};
+
+class replayer {
+    public:
+        replayer(std::shared_ptr<grpc::Channel> channel, int max_inflight) : m_stub(channel), m_max_inflight(max_inflight) {}
+
+        void issue(const tai_recorded_call_t* record) {
+            {
+                std::unique_lock<std::mutex> lk(m_mtx);
+                m_cv.wait(lk, [&]() { return m_inflight < m_max_inflight; });
+                m_inflight++;
+            }
+            auto c = new call_t;
+            c->record = record;
+            grpc::Slice slice(record->request);
+            c->req = grpc::ByteBuffer(&slice, 1);
+            c->state = call_t::START;
+            c->start = steady_clock::now();
+            c->stream = m_stub.PrepareCall(&c->ctx, "/taish.TAI/" + record->method, &m_cq);
+            c->stream->StartCall(c);
+        }
+
+        // polls the completion queue until it is shut down
+        void poll() {
+            void* tag;
+            bool ok;
+            while ( m_cq.Next(&tag, &ok) ) {
+                proceed(static_cast<call_t*>(tag), ok);
+            }
+        }
+
+        // waits for the calls in flight and stops poll()
+        void drain() {
+            std::unique_lock<std::mutex> lk(m_mtx);
+            m_cv.wait(lk, [&]() { return m_inflight == 0; });
+            m_cq.Shutdown();
+        }
+
+        const std::map<std::string, method_stats_t>& stats() const {
+            return m_stats;
+        }
+    private:
+        // unary and server streaming calls take the same steps: write the request,
+        // read until the server finishes, then get the status
+        void proceed(call_t* c, bool ok) {
+            switch (c->state) {
+            case call_t::START:
+                if ( !ok ) {
+                    break;
+                }
+                c->state = call_t::WRITE;
+                c->stream->WriteLast(c->req, grpc::WriteOptions(), c);
+                return;
+            case call_t::WRITE:
+            case call_t::READ:
+                if ( ok ) {
+                    c->state = call_t::READ;
+                    c->stream->Read(&c->res, c);
+                    return;
+                }
+                c->state = call_t::FINISH;
+                c->stream->Finish(&c->status, c);
+                return;
+            case call_t::FINISH:
+                break;
+            }
+            done(c, ok && c->status.ok() && tai_status_ok(c->ctx));
+        }
+
+        static bool tai_status_ok(const grpc::ClientContext& ctx) {
+            auto& md = ctx.GetServerTrailingMetadata();
+            auto it = md.find("tai-status-code");
+            return it == md.end() || it->second == "0";
+        }
+
+        void done(call_t* c, bool ok) {
+            auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - c->start).count();
+            std::unique_lock<std::mutex> lk(m_mtx);
+            auto& s = m_stats[c->record->method];
+            s.latencies.emplace_back(static_cast<double>(elapsed) / 1000);
+            if ( !ok ) {
+                s.errors++;
+            }
+            m_inflight--;
+            lk.unlock();
+            m_cv.notify_all();
+            delete c;
+        }
+
+        grpc::GenericStub m_stub;
+        grpc::CompletionQueue m_cq;
+        const int m_max_inflight;
+        int m_inflight = 0;
+        std::map<std::string, method_stats_t> m_stats;
+        std::mutex m_mtx;
+        std::condition_variable m_cv;
+};
+
+static void print_row(const std::string& name, std::vector<double> latencies, uint64_t errors) {
+    std::sort(latencies.begin(), latencies.end());
+    auto n = latencies.size();
+    auto p = [&](size_t q) {
+        return latencies[std::min(n - 1, n * q / 100)];
+    };
+    std::cout << std::setw(24) << name << std::setw(10) << n << std::setw(8) << errors << std::fixed << std::setprecision(1) << std::setw(12) << p(50) << std::setw(12) << p(90) << std::setw(12) << p(99) << std::setw(12) << latencies.back() << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    std::string file;
+    std::string addr = "127.0.0.1:50051";
+    double scale = 1.0;
+    int max_inflight = 64;
+    int c;
+
+    while ((c = getopt (argc, argv, "f:a:s:c:")) != -1) {
+        switch (c) {
+        case 'f':
+            file = std::string(optarg);
+            break;
+        case 'a':
+            addr = std::string(optarg);
+            break;
+        case 's':
+            scale = atof(optarg);
+            break;
+        case 'c':
+            max_inflight = atoi(optarg);
+            break;
+        default:
+            std::cerr << "usage: " << argv[0] << " -f <record file> -a <server address> -s <rate scale, 0 for no pacing> -c <max calls in flight>" << std::endl;
+            return 1;
+        }
+    }
+
+    if ( file == "" || scale < 0 || max_inflight <= 0 ) {
+        std::cerr << "a record file, a non-negative scale and a positive number of calls in flight are required" << std::endl;
+        return 1;
+    }
+
+    TAIRecordReader reader;
+    if ( reader.open(file) < 0 ) {
+        std::cerr << "failed to open record file: " << file << std::endl;
+        return 1;
+    }
+
+    std::vector<tai_recorded_call_t> records;
+    size_t skipped = 0;
+    try {
+        tai_recorded_call_t r;
+        while ( reader.next(&r) ) {
+            if ( r.method == "Monitor" || r.method == "Subscribe" ) {
+                skipped++;
+                continue;
+            }
+            records.emplace_back(r);
+        }
+    } catch ( std::runtime_error& e ) {
+        // the tail of the log may be cut when the server didn't exit cleanly
+        std::cerr << "stopped reading at a broken record: " << e.what() << std::endl;
+    }
+    if ( records.size() == 0 ) {
+        std::cerr << "no call to replay" << std::endl;
+        return 1;
+    }
+
+    auto channel = grpc::CreateChannel(addr, grpc::InsecureChannelCredentials());
+    if ( !channel->WaitForConnected(system_clock::now() + seconds(5)) ) {
+        std::cerr << "failed to connect to " << addr << std::endl;
+        return 1;
+    }
+
+    replayer r(channel, max_inflight);
+    std::thread poller(&replayer::poll, &r);
+
+    auto origin = records.front().timestamp;
+    auto start = steady_clock::now();
+    for ( auto& record : records ) {
+        if ( scale > 0 ) {
+            std::this_thread::sleep_until(start + nanoseconds(static_cast<uint64_t>((record.timestamp - origin) / scale)));
+        }
+        r.issue(&record);
+    }
+    r.drain();
+    poller.join();
+    auto elapsed = duration_cast<microseconds>(steady_clock::now() - start).count();
+    auto recorded = static_cast<double>(records.back().timestamp - origin) / 1000;
+
+    std::vector<double> all;
+    uint64_t errors = 0;
+    std::cout << std::setw(24) << "method" << std::setw(10) << "calls" << std::setw(8) << "errors" << std::setw(12) << "p50(us)" << std::setw(12) << "p90(us)" << std::setw(12) << "p99(us)" << std::setw(12) << "max(us)" << std::endl;
+    for ( auto& s : r.stats() ) {
+        print_row(s.first, s.second.latencies, s.second.errors);
+        all.insert(all.end(), s.second.latencies.begin(), s.second.latencies.end());
+        errors += s.second.errors;
+    }
+    print_row("total", all, errors);
+
+    std::cout << std::endl << "replayed " << records.size() << " calls in " << std::fixed << std::setprecision(3) << elapsed / 1e6 << "s (recorded in " << recorded / 1e6 << "s), " << std::setprecision(1) << records.size() * 1e6 / elapsed << " calls/s";
+    if ( skipped > 0 ) {
+        std::cout << ", skipped " << skipped << " streams";
+    }
+    std::cout << std::endl;
+    return 0;
+}
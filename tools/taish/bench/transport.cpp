@@ -0,0 +1,131 @@
+/**
+ * @file    transport.cpp
+ *
+ * @brief   This module measures the round-trip latency of the taish transports
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ * Serves TAIServiceImpl on TCP, on a Unix domain socket and in-process, and
+ * issues the given number of sequential GetAttributeMetadata calls over each
+ * transport. The call is served from the metadata, so no TAI adapter is needed
+ * and the result is dominated by the transport.
+ *
+ * $ LD_LIBRARY_PATH=.:../../meta ./bench/taish_bench_transport -n 10000
+ */
+
+#include "taigrpc.hpp"
+
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std::chrono;
+
+struct result_t {
+    double avg;
+    double p50;
+    double p99;
+};
+
+static result_t run(std::shared_ptr<grpc::Channel> channel, int iterations) {
+    auto stub = taish::TAI::NewStub(channel);
+    taish::GetAttributeMetadataRequest req;
+    req.set_object_type(taish::MODULE);
+    req.set_attr_name("num-host-interfaces");
+    req.mutable_serialize_option()->set_human(true);
+
+    std::vector<double> latencies;
+    // the first calls establish the connection
+    for ( int i = -10; i < iterations; i++ ) {
+        grpc::ClientContext ctx;
+        taish::GetAttributeMetadataResponse res;
+        auto start = steady_clock::now();
+        auto s = stub->GetAttributeMetadata(&ctx, req, &res);
+        auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+        if ( !s.ok() ) {
+            throw std::runtime_error("GetAttributeMetadata failed: " + s.error_message());
+        }
+        if ( i >= 0 ) {
+            latencies.emplace_back(static_cast<double>(elapsed) / 1000);
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+    result_t r{};
+    for ( auto v : latencies ) {
+        r.avg += v;
+    }
+    r.avg /= latencies.size();
+    r.p50 = latencies[latencies.size() / 2];
+    r.p99 = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+    return r;
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = 10000;
+    std::string port = "50052";
+    std::string path = "/tmp/taish_bench_transport.sock";
+    int c;
+
+    while ((c = getopt (argc, argv, "n:p:u:")) != -1) {
+        switch (c) {
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 'p':
+            port = std::string(optarg);
+            break;
+        case 'u':
+            path = std::string(optarg);
+            break;
+        default:
+            std::cerr << "usage: " << argv[0] << " -n <number of calls> -p <TCP port> -u <Unix domain socket path>" << std::endl;
+            return 1;
+        }
+    }
+
+    if ( iterations <= 0 ) {
+        std::cerr << "the number of calls must be positive" << std::endl;
+        return 1;
+    }
+
+    // GetAttributeMetadata doesn't call the TAI adapter. the metadata is looked up statically
+    tai_api_method_table_t api{};
+    TAIServiceImpl handler(&api);
+    auto tcp = "127.0.0.1:" + port;
+    auto uds = "unix:" + path;
+    TAIInProcessServer server(&handler, {tcp, uds});
+    if ( server.start() < 0 ) {
+        std::cerr << "failed to start the server on " << tcp << " and " << uds << std::endl;
+        return 1;
+    }
+
+    std::vector<std::pair<std::string, std::shared_ptr<grpc::Channel>>> transports = {
+        {"tcp", grpc::CreateChannel(tcp, grpc::InsecureChannelCredentials())},
+        {"unix", grpc::CreateChannel(uds, grpc::InsecureChannelCredentials())},
+        {"inprocess", server.channel()},
+    };
+
+    std::cout << std::setw(12) << "transport" << std::setw(12) << "avg(us)" << std::setw(12) << "p50(us)" << std::setw(12) << "p99(us)" << std::endl;
+
+    for ( auto& t : transports ) {
+        try {
+            auto r = run(t.second, iterations);
+            std::cout << std::setw(12) << t.first << std::setw(12) << std::fixed << std::setprecision(1) << r.avg << std::setw(12) << r.p50 << std::setw(12) << r.p99 << std::endl;
+        } catch ( std::runtime_error& e ) {
+            std::cerr << t.first << ": " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    server.shutdown();
+    unlink(path.c_str());
+    return 0;
+}
@@ -37,6 +37,25 @@ def set_default_serialize_option(req):
     req.serialize_option.json = False
 
 
+def from_typed_value(v):
+    """Converts taish_pb2.AttributeValue into a python value"""
+    kind = v.WhichOneof("value")
+    if kind is None:
+        return None
+    x = getattr(v, kind)
+    if kind == "u8list":
+        return list(x)
+    elif kind in ("u32range", "s32range"):
+        return (x.min, x.max)
+    elif kind == "objmaplist":
+        return {m.key: list(m.value) for m in x.list}
+    elif kind == "attrlist":
+        return [from_typed_value(e) for e in x.list]
+    elif hasattr(x, "list"):
+        return list(x.list)
+    return x
+
+
 class TAIException(Exception):
     def __init__(self, code, msg):
         self.code = code
@@ -75,18 +94,22 @@ class TAIObject(object):
     def set_multiple(self, attributes):
         return self.client.set_multiple(self.object_type, self.oid, attributes)
 
-    def get(self, attr_id, with_metadata=False, value=None, json=False):
+    def get(self, attr_id, with_metadata=False, value=None, json=False, typed=False):
         return self.client.get(
-            self.object_type, self.oid, attr_id, with_metadata, value, json
+            self.object_type, self.oid, attr_id, with_metadata, value, json, typed
         )
 
-    def get_multiple(self, attributes, with_metadata=False, json=False):
+    def get_multiple(self, attributes, with_metadata=False, json=False, typed=False):
         return self.client.get_multiple(
-            self.object_type, self.oid, attributes, with_metadata, json
+            self.object_type, self.oid, attributes, with_metadata, json, typed
         )
 
-    def monitor(self, attr_id, callback, json=False):
-        return self.client.monitor(self, attr_id, callback, json)
+    def monitor(
+        self, attr_id, callback, json=False, queue_size=0, coalesce=False, filters=None
+    ):
+        return self.client.monitor(
+            self, attr_id, callback, json, queue_size, coalesce, filters
+        )
 
 
 class NetIf(TAIObject):
@@ -174,7 +197,11 @@ class Module(TAIObject):
 
 class AsyncClient(object):
     def __init__(self, address=DEFAULT_SERVER_ADDRESS, port=DEFAULT_SERVER_PORT):
-        self.channel = aio.insecure_channel(f"{address}:{port}")
+        # e.g. "unix:/var/run/taish.sock". the port is not used
+        if address.startswith("unix:"):
+            self.channel = aio.insecure_channel(address)
+        else:
+            self.channel = aio.insecure_channel(f"{address}:{port}")
         self.stub = taish_pb2_grpc.TAIStub(self.channel)
 
     async def close(self):
@@ -335,15 +362,22 @@ class AsyncClient(object):
         check_metadata(await c.trailing_metadata())
 
     async def get(
-        self, object_type, oid, attr, with_metadata=False, value=None, json=False
+        self,
+        object_type,
+        oid,
+        attr,
+        with_metadata=False,
+        value=None,
+        json=False,
+        typed=False,
     ):
         v = await self.get_multiple(
-            object_type, oid, [(attr, value)], with_metadata, json
+            object_type, oid, [(attr, value)], with_metadata, json, typed
         )
         return v[0]
 
     async def get_multiple(
-        self, object_type, oid, attributes, with_metadata=False, json=False
+        self, object_type, oid, attributes, with_metadata=False, json=False, typed=False
     ):
         req = taish_pb2.GetAttributeRequest()
         req.oid = oid
@@ -376,6 +410,7 @@ class AsyncClient(object):
 
         set_default_serialize_option(req)
         req.serialize_option.json = json
+        req.serialize_option.typed = typed
 
         c = self.stub.GetAttribute(req)
         res = await c
@@ -383,7 +418,7 @@ class AsyncClient(object):
 
         ret = []
         for attr in res.attributes:
-            value = attr.value
+            value = from_typed_value(attr.typed_value) if typed else attr.value
             if with_metadata:
                 ret.append((value, meta))
             else:
@@ -391,7 +426,189 @@ class AsyncClient(object):
 
         return ret
 
-    async def monitor(self, obj, attr_id, callback, json=False):
+    async def bulk_get(self, objects, json=False, typed=False):
+        """Gets attributes of multiple objects in one RPC
+
+        objects is a list of (obj, [attr, ...]) where obj is a TAIObject or an oid.
+        Returns a list of lists of values in the same order. An attribute which
+        could not be retrieved is returned as a TAIException instead of a value.
+        """
+        req = taish_pb2.BulkGetAttributeRequest()
+        for obj, attrs in objects:
+            oid = obj if type(obj) == int else obj.oid
+            o = req.objects.add()
+            o.oid = oid
+            for attr in attrs:
+                if type(attr) == int:
+                    attr_id = attr
+                elif type(attr) == str:
+                    meta = await self.get_attribute_metadata(0, attr, oid=oid)
+                    attr_id = meta.attr_id
+                else:
+                    attr_id = attr.attr_id
+                o.attr_ids.append(attr_id)
+
+        set_default_serialize_option(req)
+        req.serialize_option.json = json
+        req.serialize_option.typed = typed
+
+        c = self.stub.BulkGetAttribute(req)
+        res = await c
+        check_metadata(await c.trailing_metadata())
+
+        ret = []
+        for r, o in zip(req.objects, res.objects):
+            if o.code:
+                ret.append([TAIException(o.code, o.message) for _ in r.attr_ids])
+                continue
+            ret.append(
+                [
+                    TAIException(a.code, a.message)
+                    if a.code
+                    else (from_typed_value(a.typed_value) if typed else a.value)
+                    for a in o.attributes
+                ]
+            )
+        return ret
+
+    async def provision(self, groups):
+        """Creates, sets and removes objects in one RPC
+
+        groups is a list of (module, [operation, ...]) where module is a Module, an oid
+        or None when the first operation creates the module. An operation is one of
+          ("create", "module"|"netif"|"hostif", [(attr, value), ...])
+          ("set", obj, [(attr, value), ...])
+          ("remove", obj)
+        obj is a TAIObject, an oid or None for the object created last in the group
+        (the module of the group when nothing is created yet). attr is a name or an id.
+        The operations of a group are applied in order and the rest of the group is
+        skipped once an operation fails.
+        Returns a list of lists of the oids of the created or target objects in the
+        same order. A failed or skipped operation is returned as a TAIException.
+        """
+        object_types = {
+            "module": taish_pb2.MODULE,
+            "netif": taish_pb2.NETIF,
+            "hostif": taish_pb2.HOSTIF,
+        }
+        req = taish_pb2.ProvisionRequest()
+        for module, ops in groups:
+            g = req.groups.add()
+            if module is not None:
+                g.module_id = module if type(module) == int else module.oid
+            for op in ops:
+                o = g.operations.add()
+                attrs = []
+                if op[0] == "create":
+                    o.type = taish_pb2.PROVISION_CREATE
+                    o.object_type = object_types[op[1]]
+                    attrs = op[2]
+                elif op[0] in ("set", "remove"):
+                    o.type = (
+                        taish_pb2.PROVISION_SET
+                        if op[0] == "set"
+                        else taish_pb2.PROVISION_REMOVE
+                    )
+                    obj = op[1]
+                    if obj is not None:
+                        o.oid = obj if type(obj) == int else obj.oid
+                    if op[0] == "set":
+                        attrs = op[2]
+                else:
+                    raise Exception(f"invalid operation: {op[0]}")
+                for attr, value in attrs:
+                    a = o.attrs.add()
+                    if type(attr) == int:
+                        a.attr_id = attr
+                    else:
+                        a.attr_name = attr
+                    a.value = str(value)
+
+        set_default_serialize_option(req)
+
+        c = self.stub.Provision(req)
+        res = await c
+        check_metadata(await c.trailing_metadata())
+
+        return [
+            [TAIException(o.code, o.message) if o.code else o.oid for o in g.operations]
+            for g in res.groups
+        ]
+
+    async def subscribe(self, paths, callback, json=False, on_change=False, interval=0):
+        """Streams the attribute values sampled by the server
+
+        paths is a list of (obj, attr) where obj is a TAIObject.
+        interval is the sample interval in milliseconds. 0 means the server default.
+        When on_change is True, a value is streamed only when it changed.
+        callback is called with each taish_pb2.MonitorResponse.
+        """
+        req = taish_pb2.SubscribeRequest()
+        for obj, attr in paths:
+            m = await self.get_attribute_metadata(obj.object_type, attr, oid=obj.oid)
+            p = req.paths.add()
+            p.oid = obj.oid
+            p.attr_id = m.attr_id
+            p.sample_interval_ms = interval
+            if on_change:
+                p.mode = taish_pb2.SUBSCRIBE_ON_CHANGE
+
+        set_default_serialize_option(req)
+        req.serialize_option.json = json
+
+        c = self.stub.Subscribe(req)
+
+        async for msg in c:
+            if is_async_func(callback):
+                await callback(msg)
+            else:
+                callback(msg)
+
+    async def watch_topology(self, callback):
+        """Streams the changes of the modules and their interfaces
+
+        callback is called with each taish_pb2.WatchTopologyResponse.
+        The first response has reset set and carries the whole topology.
+        """
+        req = taish_pb2.WatchTopologyRequest()
+        c = self.stub.WatchTopology(req)
+
+        async for msg in c:
+            if is_async_func(callback):
+                await callback(msg)
+            else:
+                callback(msg)
+
+    async def get_stats(self):
+        req = taish_pb2.GetStatsRequest()
+        c = self.stub.GetStats(req)
+        res = await c
+        check_metadata(await c.trailing_metadata())
+        return dict(res.counters)
+
+    async def get_histograms(self):
+        req = taish_pb2.GetStatsRequest()
+        c = self.stub.GetStats(req)
+        res = await c
+        check_metadata(await c.trailing_metadata())
+        return list(res.histograms)
+
+    async def monitor(
+        self,
+        obj,
+        attr_id,
+        callback,
+        json=False,
+        queue_size=0,
+        coalesce=False,
+        filters=None,
+    ):
+        """Streams the notifications of the notification attribute attr_id
+
+        filters is a list of the attributes to stream. all attributes are streamed when None.
+        An item can be (attr, absolute_deadband, relative_deadband) to stream the value
+        only when it moved more than the deadband from the value streamed last.
+        """
         m = await self.get_attribute_metadata(obj.object_type, attr_id, oid=obj.oid)
         if m.usage != "<notification>":
             raise Exception(
@@ -403,6 +620,18 @@ class AsyncClient(object):
         req.notification_attr_id = m.attr_id
         set_default_serialize_option(req)
         req.serialize_option.json = json
+        req.max_queue_size = queue_size
+        if coalesce:
+            req.overflow_policy = taish_pb2.MONITOR_COALESCE
+        for f in filters or []:
+            if not isinstance(f, tuple):
+                f = (f, 0, 0)
+            attr, absolute, relative = f
+            a = await self.get_attribute_metadata(obj.object_type, attr, oid=obj.oid)
+            r = req.filters.add()
+            r.attr_id = a.attr_id
+            r.absolute_deadband = absolute
+            r.relative_deadband = relative
 
         c = self.stub.Monitor(req)
 
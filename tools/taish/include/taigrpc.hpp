@@ -17,13 +17,23 @@
 #include "taimetadata.h"
 #include <grpc++/grpc++.h>
 #include <mutex>
+#include <shared_mutex>
 #include <condition_variable>
 #include <queue>
+#include <deque>
 #include <map>
+#include <set>
+#include <unordered_map>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <memory>
 #include <vector>
+#include <thread>
+#include <functional>
+#include <future>
+#include <tuple>
 
 #include "attribute.hpp"
 
@@ -58,17 +68,275 @@ struct tai_api_method_table_t
 struct tai_notification_t {
     tai_object_id_t oid;
     std::vector<tai::S_Attribute> attrs;
+    // attrs rendered with the subscriber's serialize option. shared by all subscribers
+    // which use the same option. null when attrs changed after rendering (e.g. coalesced)
+    std::shared_ptr<const taish::MonitorResponse> rendered;
 };
 
+// what to do when a notification arrives at a full subscription queue
+enum tai_overflow_policy_t {
+    TAI_OVERFLOW_POLICY_DROP_OLDEST, // drop the oldest queued notification
+    TAI_OVERFLOW_POLICY_COALESCE,    // merge into the queued notification of the same object, the latest value wins
+};
+
+struct tai_monitor_stats_t {
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> coalesced{0};
+    std::atomic<uint64_t> filtered{0}; // attribute values not streamed by the filters
+    std::atomic<uint64_t> unconverted{0}; // typed values which couldn't be converted and were streamed as strings
+};
+
+// per attribute filter of a Monitor stream. 0 disables the deadband
+struct tai_monitor_filter_t {
+    double absolute = 0;
+    double relative = 0; // fraction of the value streamed last
+};
+
+// the queue size of a Monitor stream when the client doesn't specify it
+const size_t TAI_MONITOR_DEFAULT_QUEUE_SIZE = 64;
+
 struct tai_subscription_t {
     std::mutex mtx;
-    std::queue<tai_notification_t> q;
+    std::deque<tai_notification_t> q;
+    size_t max_size = TAI_MONITOR_DEFAULT_QUEUE_SIZE;
+    tai_overflow_policy_t policy = TAI_OVERFLOW_POLICY_DROP_OLDEST;
+    tai_monitor_stats_t* stats = nullptr;
+    tai_serialize_option_t option{};
+    bool typed = false; // render notifications as taish::AttributeValue
     std::condition_variable cv;
+    // called without holding mtx after a notification is queued.
+    // the async server uses this to kick the stream instead of waiting on cv
+    std::function<void()> wakeup;
+    // the attributes to stream. empty means all attributes
+    std::map<tai_attr_id_t, tai_monitor_filter_t> filters;
+    // the values streamed last of the attributes with a deadband. only touched by TAINotifier
+    std::map<std::pair<tai_object_id_t, tai_attr_id_t>, double> last;
+
+    // queues n. when the queue is full, policy decides what to give up. mtx must be held
+    void push(const tai_notification_t& n);
+    // drops the attributes of n which the filters don't pass. returns false when nothing is left
+    bool filter(tai_notification_t* n);
+};
+
+// log2 histogram. bucket i counts the values <= 2^i and the last bucket counts the rest
+struct tai_histogram_t {
+    static const size_t NUM_BUCKETS = 24;
+    std::atomic<uint64_t> buckets[NUM_BUCKETS + 1] {};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    void observe(uint64_t v);
+};
+
+// (metric name, label, object type, attr id). object type and attr id are 0 when they don't apply
+using tai_metric_key_t = std::tuple<std::string, std::string, tai_object_type_t, tai_attr_id_t>;
+
+// TAIMetrics holds the histograms of the server
+class TAIMetrics {
+    public:
+        // returns the histogram of the key. it is created by the first call and lives as long as TAIMetrics
+        tai_histogram_t* histogram(const std::string& name, const std::string& label, tai_object_type_t type = TAI_OBJECT_TYPE_NULL, tai_attr_id_t id = 0);
+        void snapshot(taish::GetStatsResponse* res);
+    private:
+        std::map<tai_metric_key_t, std::unique_ptr<tai_histogram_t>> m_histograms;
+        std::shared_mutex m_mtx; // mutex to protect m_histograms
+};
+
+// observes the elapsed time in microseconds when it goes out of scope
+class TAIMetricsTimer {
+    public:
+        TAIMetricsTimer(tai_histogram_t* h) : m_histogram(h), m_start(std::chrono::steady_clock::now()) {}
+        TAIMetricsTimer(const TAIMetricsTimer&) = delete;
+        ~TAIMetricsTimer() {
+            auto elapsed = std::chrono::steady_clock::now() - m_start;
+            m_histogram->observe(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+        }
+    private:
+        tai_histogram_t* m_histogram;
+        std::chrono::steady_clock::time_point m_start;
+};
+
+// one RPC in the record log
+struct tai_recorded_call_t {
+    std::string method;  // e.g. "GetAttribute"
+    std::string peer;    // ServerContext::peer() of the caller
+    uint64_t timestamp;  // nanoseconds since the epoch when the call arrived
+    std::string request; // the serialized request message
+};
+
+// the first bytes of a record log
+const char TAI_RECORD_MAGIC[] = "TAIREC1";
+
+// TAIRecorder appends the incoming RPCs to a binary log which taish_bench_replay re-issues.
+// the log starts with TAI_RECORD_MAGIC. each record is a varint timestamp delta from the
+// previous record followed by the method, the peer and the request. the method and the peer
+// are varint indexes of the strings seen so far. a new string is written after its index
+// the first time it appears. the request is a varint length followed by the bytes
+class TAIRecorder {
+    public:
+        ~TAIRecorder();
+        int open(const std::string& path);
+        void record(const std::string& method, const std::string& peer, const google::protobuf::Message& request);
+        // flushes the log. the records after close() are dropped
+        void close();
+        uint64_t recorded() const {
+            return m_recorded;
+        }
+    private:
+        FILE* m_fp = nullptr;
+        uint64_t m_last = 0; // timestamp of the last record
+        std::unordered_map<std::string, uint64_t> m_methods;
+        std::unordered_map<std::string, uint64_t> m_peers;
+        std::chrono::steady_clock::time_point m_flushed;
+        std::mutex m_mtx;
+        std::atomic<uint64_t> m_recorded{0};
+};
+
+// TAIRecordReader reads the log written by TAIRecorder
+class TAIRecordReader {
+    public:
+        ~TAIRecordReader();
+        int open(const std::string& path);
+        // returns false at the end of the log. throws std::runtime_error when the log is broken
+        bool next(tai_recorded_call_t* call);
+    private:
+        bool read_varint(uint64_t* v);
+        std::string read_string(std::vector<std::string>* table);
+        FILE* m_fp = nullptr;
+        uint64_t m_last = 0;
+        std::vector<std::string> m_methods;
+        std::vector<std::string> m_peers;
+};
+
+struct tai_cache_stats_t {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stale; // lookups which found an expired entry. also counted as misses
+    uint64_t invalidations;
+    uint64_t entries;
+};
+
+// key: (object type, attribute short name), value: max-age of the cached value
+using tai_cache_policy_t = std::map<std::pair<tai_object_type_t, std::string>, std::chrono::milliseconds>;
+
+// TAIAttributeCache caches the attribute values read from the TAI adapter.
+// only the attributes which have a max-age in the policy are cached
+class TAIAttributeCache {
+    public:
+        TAIAttributeCache(const tai_cache_policy_t& policy) : m_policy(policy) {};
+        // returns nullptr when the attribute is not cached or the cached value is older than its max-age
+        tai::S_Attribute get(tai_object_id_t oid, const tai_attr_metadata_t* const meta);
+        // returns the generation to pass to put(). take it before reading the value from the adapter
+        uint64_t generation() {
+            return m_generation;
+        }
+        // caches attr unless an invalidation happened since generation was taken
+        void put(tai_object_id_t oid, const tai_attr_metadata_t* const meta, tai::S_Attribute attr, uint64_t generation);
+        void invalidate(tai_object_id_t oid, tai_attr_id_t id);
+        void invalidate(tai_object_id_t oid);
+        // drops all the entries and the resolved max-ages, e.g. when a module is removed
+        void clear();
+        tai_cache_stats_t stats();
+    private:
+        std::chrono::milliseconds max_age(const tai_attr_metadata_t* const meta);
+
+        struct entry_t {
+            tai::S_Attribute attr;
+            std::chrono::steady_clock::time_point expire;
+        };
+
+        const tai_cache_policy_t m_policy;
+        std::unordered_map<const tai_attr_metadata_t*, std::chrono::milliseconds> m_max_age; // m_policy resolved per metadata. cleared with the metadata
+        std::map<std::pair<tai_object_id_t, tai_attr_id_t>, entry_t> m_entries;
+        std::mutex m_mtx; // mutex to protect m_max_age and m_entries
+        std::atomic<uint64_t> m_generation{0};
+        std::atomic<uint64_t> m_hits{0}, m_misses{0}, m_stale{0}, m_invalidations{0};
+};
+
+// a token bucket budget. calls per second and the number of calls which can be made back to back.
+// rate 0 means unlimited
+struct tai_rate_limit_t {
+    double rate;
+    double burst;
+};
+
+struct tai_admission_policy_t {
+    tai_rate_limit_t peer;   // per client address
+    tai_rate_limit_t module; // per module, shared by all clients
+};
+
+enum tai_admission_t {
+    TAI_ADMISSION_ADMITTED,
+    TAI_ADMISSION_REJECTED_PEER,   // the bucket of the peer is empty
+    TAI_ADMISSION_REJECTED_MODULE, // the bucket of one of the modules is empty
+};
+
+struct tai_admission_stats_t {
+    std::atomic<uint64_t> rejected_peer{0};
+    std::atomic<uint64_t> rejected_module{0};
+};
+
+// TAIAdmission rations the calls which reach the TAI adapter with token buckets per peer and per module
+class TAIAdmission {
+    public:
+        TAIAdmission(const tai_admission_policy_t& policy) : m_policy(policy) {}
+        // takes a token of the bucket of the peer and of each module at once. when one of the buckets
+        // is empty, no token is taken so that a rejected call doesn't spend the budget of the others
+        tai_admission_t admit(const std::string& peer, const std::set<tai_object_id_t>& modules);
+        // drops the bucket of a removed module
+        void forget_module(tai_object_id_t mid);
+        const tai_admission_stats_t& stats() const {
+            return m_stats;
+        }
+    private:
+        struct bucket_t {
+            double tokens;
+            std::chrono::steady_clock::time_point last;
+        };
+        static void refill(bucket_t& b, const tai_rate_limit_t& limit, std::chrono::steady_clock::time_point now);
+        // drops the buckets which are full again when there are too many. m_mtx must be held
+        template<typename K>
+        static void prune(std::unordered_map<K, bucket_t>& buckets, const tai_rate_limit_t& limit, std::chrono::steady_clock::time_point now);
+        // returns the refilled bucket of key, adding a full one for a new key. m_mtx must be held
+        template<typename K>
+        static bucket_t& find(std::unordered_map<K, bucket_t>& buckets, const K& key, const tai_rate_limit_t& limit, std::chrono::steady_clock::time_point now);
+
+        const tai_admission_policy_t m_policy;
+        std::unordered_map<std::string, bucket_t> m_peers;
+        std::unordered_map<tai_object_id_t, bucket_t> m_modules;
+        std::mutex m_mtx; // mutex to protect m_peers and m_modules
+        tai_admission_stats_t m_stats;
+};
+
+// TAISingleFlight coalesces the concurrent reads of the same attribute.
+// the first caller reads the value and the callers which arrive while the read is in flight
+// share its result instead of calling the adapter again
+class TAISingleFlight {
+    public:
+        using result_t = std::shared_future<tai::S_Attribute>;
+        // returns the result of read. when a read of the same (oid, id, hint) is in flight, waits for it
+        // with wait and returns its result instead of calling read. wait returns false when the caller
+        // gives up waiting, and run returns nullptr then. the exception thrown by read is rethrown to every caller
+        tai::S_Attribute run(tai_object_id_t oid, tai_attr_id_t id, const std::string& hint, std::function<tai::S_Attribute()> read, std::function<bool(const result_t&)> wait);
+        // the reads of oid in flight are not joined anymore. call this when oid is changed
+        void forget(tai_object_id_t oid);
+        uint64_t coalesced() {
+            return m_coalesced;
+        }
+    private:
+        using key_t = std::tuple<tai_object_id_t, tai_attr_id_t, std::string>;
+        struct call_t {
+            uint64_t seq; // tells the call from the ones started after forget()
+            result_t result;
+        };
+        std::map<key_t, call_t> m_calls;
+        uint64_t m_seq = 0;
+        std::mutex m_mtx; // mutex to protect m_calls and m_seq
+        std::atomic<uint64_t> m_coalesced{0};
 };
 
 class TAINotifier {
     public:
-        TAINotifier(tai_meta_api_t* m) : m_meta_api(m) {};
+        TAINotifier(tai_meta_api_t* m, TAIAttributeCache* cache = nullptr) : m_meta_api(m), m_cache(cache) {};
         int notify(const tai_notification_t& n);
         int subscribe(void* id, tai_subscription_t* s) {
             std::unique_lock<std::mutex> lk(mtx);
@@ -93,15 +361,260 @@ class TAINotifier {
         tai_meta_api_t* meta_api() {
             return m_meta_api;
         }
+        TAIAttributeCache* cache() {
+            return m_cache;
+        }
     private:
         std::map<void*, tai_subscription_t*> m;
         std::mutex mtx;
         tai_meta_api_t* m_meta_api;
+        TAIAttributeCache* m_cache;
+};
+
+// state of one Monitor stream, shared by the sync and the async server
+struct tai_monitor_t {
+    tai_object_id_t oid;
+    tai_attr_id_t nid;
+    tai_object_type_t type;
+    tai_attribute_t attr;
+    tai_subscription_t subscription;
+    std::shared_ptr<TAINotifier> notifier;
+
+    bool subscribed() const {
+        return notifier != nullptr;
+    }
+};
+
+struct tai_telemetry_path_t {
+    tai_object_id_t oid;
+    tai_object_id_t module; // the module of oid. removing it removes oid as well
+    tai_attr_id_t id;
+    uint64_t interval; // in sampler ticks
+    bool on_change;
+    std::string last; // the value delivered last. only used when on_change is true
+};
+
+// state of one Subscribe stream
+struct tai_telemetry_t {
+    std::vector<tai_telemetry_path_t> paths;
+    tai_subscription_t subscription;
+    bool scheduled = false;
+    std::atomic<bool> removed{false}; // a sampled object is removed. set by TAISampler
+
+    bool subscribed() const {
+        return scheduled;
+    }
+};
+
+// an immutable view of the modules and their interfaces. a change is published as a new
+// snapshot with the next version instead of modifying the current one
+struct tai_topology_t {
+    uint64_t version = 0;
+    std::vector<tai_api_module_t> modules; // sorted by location. no interface when the module is not created
+};
+
+// queue of a WatchTopology stream
+struct tai_topology_subscription_t {
+    std::mutex mtx;
+    std::deque<std::shared_ptr<const taish::WatchTopologyResponse>> q;
+    std::condition_variable cv;
+    // same as tai_subscription_t::wakeup
+    std::function<void()> wakeup;
+};
+
+// state of one WatchTopology stream
+struct tai_topology_watch_t {
+    tai_topology_subscription_t subscription;
+    bool watching = false;
+
+    bool subscribed() const {
+        return watching;
+    }
+};
+
+// the responses queued to a WatchTopology stream which doesn't keep up. the queue is replaced
+// by the whole topology when it gets longer
+const size_t TAI_TOPOLOGY_MAX_QUEUE_SIZE = 256;
+
+// TAITopology holds the current topology snapshot. the application publishes a new snapshot
+// when modules or interfaces come and go, and readers take the current one without waiting for
+// the application. the changes are pushed to the watchers as add/remove/update events
+class TAITopology {
+    public:
+        TAITopology() : m_current(std::make_shared<const tai_topology_t>()) {}
+        std::shared_ptr<const tai_topology_t> snapshot() const {
+            return std::atomic_load(&m_current);
+        }
+        // replaces the snapshot with modules as the next version
+        void publish(std::vector<tai_api_module_t> modules);
+        // queues the whole topology to s, then the changes until unwatch() is called
+        void watch(tai_topology_subscription_t* s);
+        void unwatch(tai_topology_subscription_t* s);
+    private:
+        std::shared_ptr<const tai_topology_t> m_current;
+        std::vector<tai_topology_subscription_t*> m_watchers;
+        std::mutex m_mtx; // serializes publish() and protects m_watchers
+};
+
+class TAIServiceImpl;
+
+// TAISampler reads the subscribed attributes periodically and queues the values
+// to the subscriptions. paths are kept in a hashed timer wheel so that a tick only
+// visits the paths which may be due. the reads of a tick are batched per module
+class TAISampler {
+    public:
+        TAISampler(TAIServiceImpl* handler, std::chrono::milliseconds tick = std::chrono::milliseconds(100), size_t slots = 512) : m_handler(handler), m_tick_interval(tick), m_wheel(slots) {};
+        ~TAISampler();
+        // schedules all paths of t. the first samples are taken in the next tick
+        void add(tai_telemetry_t* t);
+        // unschedules t. t is never touched after this returns
+        void remove(tai_telemetry_t* t);
+        // unschedules the streams which sample oid, or an interface of oid when it is a module,
+        // and wakes them up to end with t->removed set
+        void object_removed(tai_object_id_t oid);
+        std::chrono::milliseconds tick_interval() const {
+            return m_tick_interval;
+        }
+    private:
+        struct entry_t {
+            tai_telemetry_t* t;
+            size_t index; // index of t->paths
+            uint64_t rounds; // number of wheel rotations to wait
+            uint64_t seq; // the add() of t. tells t from a stream added later at the same address
+        };
+        // m_mtx must be held
+        void schedule(const entry_t& e, uint64_t ticks);
+        // lk holds m_mtx. it is released while the adapter is read, and the entries whose stream
+        // was removed meanwhile are dropped
+        void sample(const std::vector<entry_t>& due, std::unique_lock<std::mutex>& lk);
+        void run();
+
+        TAIServiceImpl* m_handler;
+        const std::chrono::milliseconds m_tick_interval;
+        std::vector<std::vector<entry_t>> m_wheel;
+        uint64_t m_tick = 0; // the last tick processed
+        size_t m_size = 0; // number of entries in m_wheel
+        std::unordered_map<tai_telemetry_t*, uint64_t> m_streams; // the streams not removed yet and their seq
+        uint64_t m_seq = 0;
+        bool m_stop = false;
+        std::mutex m_mtx; // protects the members above and the paths of the streams
+        std::condition_variable m_cv;
+        std::thread m_thread; // started by the first add()
+};
+
+// classes of the TAI adapter calls. a lower value is served first
+enum tai_priority_t {
+    TAI_PRIORITY_CONTROL,  // create/remove/set/clear, and the notification setup of Monitor
+    TAI_PRIORITY_GET,      // attribute reads, including the samples of Subscribe
+    TAI_PRIORITY_METADATA, // capabilities
+    TAI_PRIORITY_MAX,
+};
+
+// a waiter which has waited this long is served before the waiters of higher classes
+const auto TAI_PRIORITY_MAX_WAIT = std::chrono::milliseconds(100);
+
+// TAIPriorityMutex is a mutex which is handed over to the waiter of the highest class.
+// waiters of the same class are served in the arrival order. a waiter which has waited longer
+// than max_wait is served first regardless of its class so that the lower classes don't starve
+class TAIPriorityMutex {
+    public:
+        TAIPriorityMutex(std::chrono::milliseconds max_wait = TAI_PRIORITY_MAX_WAIT) : m_max_wait(max_wait) {}
+        // since is when the caller started waiting. a retry with the same since keeps its place in the queue.
+        // returns false when the deadline passed before the mutex is handed over
+        bool try_lock_until(tai_priority_t cls, std::chrono::steady_clock::time_point since, std::chrono::system_clock::time_point deadline);
+        void unlock();
+    private:
+        struct waiter_t {
+            std::condition_variable cv;
+            bool granted = false;
+        };
+        using arrival_t = std::pair<std::chrono::steady_clock::time_point, uint64_t>;
+        std::mutex m_mtx;
+        bool m_locked = false; // the mutex is handed over without being unlocked while there are waiters
+        std::map<std::pair<tai_priority_t, arrival_t>, waiter_t*> m_waiters; // by class, then arrival
+        std::map<arrival_t, tai_priority_t> m_arrivals; // by arrival, to find a starving waiter
+        uint64_t m_seq = 0;
+        const std::chrono::milliseconds m_max_wait;
+};
+
+// TAIPriorityLock owns a TAIPriorityMutex like std::unique_lock.
+// it is created without locking and remembers when the owner started waiting
+class TAIPriorityLock {
+    public:
+        TAIPriorityLock() {}
+        TAIPriorityLock(TAIPriorityMutex* mtx, tai_priority_t cls) : m_mtx(mtx), m_cls(cls), m_since(std::chrono::steady_clock::now()) {}
+        TAIPriorityLock(const TAIPriorityLock&) = delete;
+        TAIPriorityLock(TAIPriorityLock&& other) : m_mtx(other.m_mtx), m_cls(other.m_cls), m_since(other.m_since), m_owns(other.m_owns) {
+            other.m_owns = false;
+        }
+        TAIPriorityLock& operator=(TAIPriorityLock&& other) {
+            if ( m_owns ) {
+                m_mtx->unlock();
+            }
+            m_mtx = other.m_mtx;
+            m_cls = other.m_cls;
+            m_since = other.m_since;
+            m_owns = other.m_owns;
+            other.m_owns = false;
+            return *this;
+        }
+        ~TAIPriorityLock() {
+            if ( m_owns ) {
+                m_mtx->unlock();
+            }
+        }
+        void lock() {
+            m_owns = m_mtx->try_lock_until(m_cls, m_since, std::chrono::system_clock::time_point::max());
+        }
+        bool try_lock_until(std::chrono::system_clock::time_point deadline) {
+            m_owns = m_mtx->try_lock_until(m_cls, m_since, deadline);
+            return m_owns;
+        }
+        bool owns_lock() const {
+            return m_owns;
+        }
+    private:
+        TAIPriorityMutex* m_mtx = nullptr;
+        tai_priority_t m_cls = TAI_PRIORITY_CONTROL;
+        std::chrono::steady_clock::time_point m_since;
+        bool m_owns = false;
+};
+
+// tai_api_lock_t holds the locks which must be held while calling the TAI adapter.
+// members are released in the reverse order of the declaration
+struct tai_api_lock_t {
+    // held with exclusive. the shared holders come through it so that they queue up by class behind a create/remove
+    TAIPriorityLock gate;
+    std::unique_lock<std::shared_timed_mutex> exclusive;
+    std::shared_lock<std::shared_timed_mutex> shared;
+    // serializes the calls to the adapter, or to the module when the adapter is module thread safe
+    TAIPriorityLock serial;
+    // not OK when the caller gave up waiting for the locks. no lock is held then
+    ::grpc::Status status;
+};
+
+struct tai_service_option_t {
+    // by default, all TAI adapter calls are serialized.
+    // when module_thread_safe is true, the adapter is considered safe to be called
+    // concurrently for different modules. calls to the same module are still serialized
+    // and calls which create/remove objects are serialized against all others
+    bool module_thread_safe;
+    // attributes to cache. empty means no caching
+    tai_cache_policy_t cache;
+    // records the incoming RPCs when it is not null
+    TAIRecorder* recorder;
+    // budgets of the calls which reach the TAI adapter. no limit by default
+    tai_admission_policy_t admission;
+    // ListModule is served from the snapshot and WatchTopology is available when it is not null.
+    // otherwise ListModule calls tai_api_method_table_t::list_module
+    TAITopology* topology;
 };
 
 class TAIServiceImpl final : public taish::TAI::Service {
     public:
-        TAIServiceImpl(const tai_api_method_table_t* const api) : m_api(api) {};
+        TAIServiceImpl(const tai_api_method_table_t* const api, const tai_service_option_t& option = {}) : m_api(api), m_module_thread_safe(option.module_thread_safe), m_recorder(option.recorder), m_admission(option.admission), m_topology(option.topology), m_cache(option.cache) {
+            prepare_metadata();
+        };
         ::grpc::Status ListModule(::grpc::ServerContext* context, const taish::ListModuleRequest* request, ::grpc::ServerWriter< taish::ListModuleResponse>* writer);
         ::grpc::Status ListAttributeMetadata(::grpc::ServerContext* context, const taish::ListAttributeMetadataRequest* request, ::grpc::ServerWriter< taish::ListAttributeMetadataResponse>* writer);
         ::grpc::Status GetAttributeMetadata(::grpc::ServerContext* context, const taish::GetAttributeMetadataRequest* request, taish::GetAttributeMetadataResponse* response);
@@ -113,20 +626,211 @@ class TAIServiceImpl final : public taish::TAI::Service {
         ::grpc::Status SetLogLevel(::grpc::ServerContext* context, const taish::SetLogLevelRequest* request, taish::SetLogLevelResponse* response);
         ::grpc::Status Create(::grpc::ServerContext* context, const taish::CreateRequest* request, taish::CreateResponse* response);
         ::grpc::Status Remove(::grpc::ServerContext* context, const taish::RemoveRequest* request, taish::RemoveResponse* response);
+        ::grpc::Status BulkGetAttribute(::grpc::ServerContext* context, const taish::BulkGetAttributeRequest* request, taish::BulkGetAttributeResponse* response);
+        ::grpc::Status GetStats(::grpc::ServerContext* context, const taish::GetStatsRequest* request, taish::GetStatsResponse* response);
+        ::grpc::Status Subscribe(::grpc::ServerContext* context, const taish::SubscribeRequest* request, ::grpc::ServerWriter< taish::MonitorResponse>* writer);
+        ::grpc::Status Provision(::grpc::ServerContext* context, const taish::ProvisionRequest* request, taish::ProvisionResponse* response);
+        ::grpc::Status WatchTopology(::grpc::ServerContext* context, const taish::WatchTopologyRequest* request, ::grpc::ServerWriter< taish::WatchTopologyResponse>* writer);
+
+        // building blocks of the streaming RPCs which don't depend on the gRPC API flavor (sync or async)
+        ::grpc::Status list_module(::grpc::ServerContext* context, const taish::ListModuleRequest* request, std::function<bool(const taish::ListModuleResponse&)> write);
+        ::grpc::Status list_attribute_metadata(::grpc::ServerContext* context, const taish::ListAttributeMetadataRequest* request, std::function<bool(const taish::ListAttributeMetadataResponse&)> write);
+
+        // sets up the notify attribute and subscribes m->subscription.
+        // m->notifier is non-null only when the subscription succeeded
+        ::grpc::Status start_monitor(::grpc::ServerContext* context, const taish::MonitorRequest* request, tai_monitor_t* m);
+        ::grpc::Status stop_monitor(::grpc::ServerContext* context, tai_monitor_t* m);
+        // returns false when the monitored object has been removed
+        bool is_monitoring(const tai_monitor_t* m);
+        // validates the paths and schedules them to the sampler.
+        // t->subscribed() is true only when the paths are scheduled
+        ::grpc::Status start_subscribe(::grpc::ServerContext* context, const taish::SubscribeRequest* request, tai_telemetry_t* t);
+        ::grpc::Status stop_subscribe(::grpc::ServerContext* context, tai_telemetry_t* t);
+        // returns false when a sampled object has been removed
+        bool is_sampling(const tai_telemetry_t* t);
+        // w->subscribed() is true only when the topology is watched
+        ::grpc::Status start_watch_topology(::grpc::ServerContext* context, const taish::WatchTopologyRequest* request, tai_topology_watch_t* w);
+        ::grpc::Status stop_watch_topology(::grpc::ServerContext* context, tai_topology_watch_t* w);
+        // the counters and histograms of GetStats in the Prometheus text exposition format
+        std::string stats_text();
+        // drains all queued notifications into res. returns the number of notifications
+        size_t pop_notifications(tai_subscription_t* s, std::vector<std::shared_ptr<const taish::MonitorResponse>>* res);
+        size_t pop_notifications(tai_topology_subscription_t* s, std::vector<std::shared_ptr<const taish::WatchTopologyResponse>>* res);
+        // sets the attributes of the object with one set_*_attributes call, taking the adapter lock
+        // like SetAttribute. the application uses this to change objects behind the server's back
+        // without making the cached values stale
+        tai_status_t set_attributes(tai_object_id_t oid, const std::vector<tai::S_Attribute>& attrs);
+        // creates an object with one create_* call, taking the adapter lock exclusively like Create.
+        // the application uses this to create the objects it brings up by itself. mid is ignored for a module
+        tai_status_t create(tai_object_type_t type, tai_object_id_t mid, const std::vector<tai_attribute_t>& attrs, tai_object_id_t* oid);
+        // gets the attributes of a module with one get_module_attributes call, taking the adapter lock like Get.
+        // unlike read_attributes() the cache is bypassed, so that the application's own reads don't fill it
+        tai_status_t get_module_attributes(tai_object_id_t oid, std::vector<tai_attribute_t>& attrs);
+        // reads the attributes of the objects, taking the adapter lock once per module.
+        // (*values)[oid][i] is nullptr when reading objects[oid][i] failed
+        void read_attributes(const std::map<tai_object_id_t, std::vector<tai_attr_id_t>>& objects, std::map<tai_object_id_t, std::vector<tai::S_Attribute>>* values);
     private:
         std::shared_ptr<TAINotifier> get_notifier(tai_object_id_t oid, tai_attr_id_t nid) {
             auto key = std::pair<tai_object_id_t, tai_attr_id_t>(oid, nid);
             if ( m_notifiers.find(key) == m_notifiers.end() ) {
-                m_notifiers[key] = std::make_shared<TAINotifier>(m_api->meta_api);
+                m_notifiers[key] = std::make_shared<TAINotifier>(m_api->meta_api, &m_cache);
             }
             return m_notifiers[key];
         }
+        // reads the attributes of one object with a single get_*_attributes call. the adapter lock must be held.
+        // returns an error only when the object is invalid. (*attrs)[i] is nullptr when (*rets)[i] is an error
+        tai_status_t read_object_attributes(tai_object_id_t oid, const std::vector<tai_attr_id_t>& ids, std::vector<tai::S_Attribute>* attrs, std::vector<tai_status_t>* rets);
+        // same as read_object_attributes() but renders the result
+        void get_object_attributes(const taish::ObjectAttributeIds& request, tai_serialize_option_t* option, bool typed, taish::ObjectAttributeResults* response);
+
+        // converts the attributes of a request. key is the object, or its type and location when the object is not created yet
+        tai_status_t resolve_attributes(const tai_metadata_key_t* const key, const google::protobuf::RepeatedPtrField<taish::Attribute>& src, tai_serialize_option_t* option, std::vector<tai::S_Attribute>* dst);
+        // create_object(), set_object_attributes() and remove_object() call the TAI adapter. the adapter lock must be held.
+        // object_created() and object_removed() must be called after create_object() and remove_object() succeeded,
+        // without holding the adapter lock
+        tai_status_t create_object(tai_object_type_t type, tai_object_id_t mid, const google::protobuf::RepeatedPtrField<taish::Attribute>& src, tai_serialize_option_t* option, tai_object_id_t* oid, int* index);
+        tai_status_t set_object_attributes(tai_object_id_t oid, const std::vector<tai::S_Attribute>& attrs);
+        tai_status_t remove_object(tai_object_id_t oid);
+        void object_created(tai_object_type_t type, tai_object_id_t oid, int index);
+        void object_removed(tai_object_type_t type, tai_object_id_t oid);
+
+        // appends the RPC to the record log when recording is enabled. usage: record(context, __func__, *request);
+        void record(::grpc::ServerContext* context, const char* method, const google::protobuf::Message& request) {
+            if ( m_recorder != nullptr ) {
+                m_recorder->record(method, context->peer(), request);
+            }
+        }
+        // takes a token of the peer of context and of the module of each oid.
+        // returns RESOURCE_EXHAUSTED when any of them is over budget
+        ::grpc::Status admit(::grpc::ServerContext* context, const std::vector<tai_object_id_t>& oids = {});
+        // measures an RPC. usage: auto timer = rpc_timer(__func__);
+        TAIMetricsTimer rpc_timer(const char* method) {
+            return TAIMetricsTimer(m_metrics.histogram("rpc_latency_us", method));
+        }
+        // measures a TAI adapter call
+        TAIMetricsTimer adapter_timer(const char* op, tai_object_type_t type, tai_attr_id_t id = 0) {
+            return TAIMetricsTimer(m_metrics.histogram("adapter_latency_us", op, type, id));
+        }
+        void collect_stats(taish::GetStatsResponse* response);
+
+        // returns the ListAttributeMetadataResponse of meta. converted once and shared by all calls
+        std::shared_ptr<const taish::ListAttributeMetadataResponse> metadata_response(const tai_attr_metadata_t* const meta);
+        // converts the metadata of all object types, or of oid when it is given, ahead of the requests
+        void prepare_metadata(tai_object_id_t oid = TAI_NULL_OBJECT_ID);
+
+        // locks to call the TAI adapter on oid. the waiters of a higher class are served first.
+        // when context is given, its "taish-priority" metadata overrides cls and the wait is given up
+        // once the call is expired or cancelled. check status of the result
+        tai_api_lock_t lock_object(tai_object_id_t oid, tai_priority_t cls, ::grpc::ServerContext* context = nullptr);
+        // locks to call the TAI adapter exclusively (e.g. create/remove objects)
+        tai_api_lock_t lock_all(::grpc::ServerContext* context = nullptr);
+        // waits for lk on behalf of context. counts the calls which gave up
+        template<typename Lock>
+        ::grpc::Status acquire(Lock& lk, ::grpc::ServerContext* context);
+
         const tai_api_method_table_t* const m_api;
-        std::mutex m_mtx; // mutex for serialized TAI API calls
+        const bool m_module_thread_safe;
+        TAIRecorder* const m_recorder;
+        TAIAdmission m_admission;
+        TAITopology* const m_topology;
+        std::shared_timed_mutex m_mtx; // taken exclusively to create/remove objects when m_module_thread_safe is true
+        // m_mtx is taken through m_gate. a create/remove holds it from before waiting for the shared
+        // holders to leave until it is done, so that the calls which come later don't keep m_mtx shared
+        // forever and are handed over by class once it is done
+        TAIPriorityMutex m_gate;
+        TAIPriorityMutex m_serial_mtx; // mutex for serialized TAI API calls when m_module_thread_safe is false
+
+        std::map<tai_object_id_t, std::unique_ptr<TAIPriorityMutex>> m_module_mtxs; // per-module mutexes used when m_module_thread_safe is true
+        std::mutex m_module_mtxs_mtx; // mutex to protect m_module_mtxs
+        // calls which gave up waiting for the adapter lock
+        std::atomic<uint64_t> m_shed_expired{0};
+        std::atomic<uint64_t> m_shed_cancelled{0};
+
+        TAIAttributeCache m_cache;
+        TAISingleFlight m_flights; // GetAttribute reads in flight
+
+        // cleared when a module is removed since the adapter may free the metadata which depend on the module
+        std::unordered_map<const tai_attr_metadata_t*, std::shared_ptr<const taish::ListAttributeMetadataResponse>> m_metadata;
+        std::shared_mutex m_metadata_mtx; // mutex to protect m_metadata
+        tai_monitor_stats_t m_monitor_stats;
+        TAIMetrics m_metrics;
 
         std::map<std::pair<tai_object_id_t, tai_attr_id_t>, std::shared_ptr<TAINotifier>> m_notifiers;
         std::mutex m_notifiers_mtx; // mutex to protect m_notifiers
 
+        // declared last so that its thread stops before the members it uses are destroyed
+        TAISampler m_sampler{this};
+};
+
+class TAIAsyncCall;
+class TAIWorkerPool;
+
+// TAIAsyncServiceImpl serves the taish API with the completion queue based async gRPC API.
+// A Monitor stream doesn't pin a thread for its lifetime.
+// Completion queues are polled by num_pollers threads and blocking TAI adapter calls
+// are executed by num_workers threads so that pollers never block on the adapter.
+//
+// usage:
+//   TAIServiceImpl handler(&api);
+//   TAIAsyncServiceImpl service(&handler, pollers, workers);
+//   service.register_service(builder);
+//   auto server = builder.BuildAndStart();
+//   service.start();
+//   ...
+//   server->Shutdown();
+//   service.shutdown();
+class TAIAsyncServiceImpl {
+    public:
+        TAIAsyncServiceImpl(TAIServiceImpl* handler, int num_pollers = 1, int num_workers = 1);
+        ~TAIAsyncServiceImpl();
+        int register_service(::grpc::ServerBuilder& builder);
+        int start();
+        int shutdown();
+
+        TAIServiceImpl* handler() {
+            return m_handler;
+        }
+        taish::TAI::AsyncService* service() {
+            return &m_service;
+        }
+        TAIWorkerPool* workers() {
+            return m_workers.get();
+        }
+    private:
+        void poll(::grpc::ServerCompletionQueue* cq);
+        void request_calls(::grpc::ServerCompletionQueue* cq);
+        TAIServiceImpl* m_handler;
+        taish::TAI::AsyncService m_service;
+        int m_num_pollers;
+        std::unique_ptr<TAIWorkerPool> m_workers;
+        std::vector<std::unique_ptr<::grpc::ServerCompletionQueue>> m_cqs;
+        std::vector<std::thread> m_pollers;
+};
+
+// TAIInProcessServer serves the taish API to the gRPC clients in the same process.
+// The calls over channel() don't go through any socket.
+// Since a service can be registered only to one server, the addresses which the same
+// service listens on (e.g. "unix:/var/run/taish.sock") are given together.
+//
+// usage:
+//   TAIServiceImpl handler(&api);
+//   TAIInProcessServer server(&handler);
+//   server.start();
+//   auto stub = taish::TAI::NewStub(server.channel());
+//   ...
+//   server.shutdown();
+class TAIInProcessServer {
+    public:
+        TAIInProcessServer(TAIServiceImpl* handler, const std::vector<std::string>& addrs = {}) : m_handler(handler), m_addrs(addrs) {}
+        ~TAIInProcessServer();
+        int start();
+        int shutdown();
+        // returns nullptr when the server is not started
+        std::shared_ptr<::grpc::Channel> channel();
+    private:
+        TAIServiceImpl* m_handler;
+        std::vector<std::string> m_addrs;
+        std::unique_ptr<::grpc::Server> m_server;
 };
 
 const tai_attr_metadata_t* const get_metadata(tai_meta_api_t* meta_api, const tai_metadata_key_t * const key, tai_attr_id_t attr_id);
@@ -0,0 +1,86 @@
+/**
+ * @file    admission.cpp
+ *
+ * @brief   This module implements the admission control of TAI gRPC server
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "taigrpc.hpp"
+
+// the buckets which are full again are dropped when there are more than this many,
+// so that the buckets of short-lived clients don't pile up
+static const size_t TAI_ADMISSION_MAX_BUCKETS = 1024;
+
+void TAIAdmission::refill(bucket_t& b, const tai_rate_limit_t& limit, std::chrono::steady_clock::time_point now) {
+    std::chrono::duration<double> elapsed = now - b.last;
+    b.tokens = std::min(limit.burst, b.tokens + elapsed.count() * limit.rate);
+    b.last = now;
+}
+
+template<typename K>
+void TAIAdmission::prune(std::unordered_map<K, bucket_t>& buckets, const tai_rate_limit_t& limit, std::chrono::steady_clock::time_point now) {
+    if ( buckets.size() < TAI_ADMISSION_MAX_BUCKETS ) {
+        return;
+    }
+    for ( auto i = buckets.begin(); i != buckets.end(); ) {
+        refill(i->second, limit, now);
+        i = i->second.tokens >= limit.burst ? buckets.erase(i) : std::next(i);
+    }
+}
+
+template<typename K>
+TAIAdmission::bucket_t& TAIAdmission::find(std::unordered_map<K, bucket_t>& buckets, const K& key, const tai_rate_limit_t& limit, std::chrono::steady_clock::time_point now) {
+    auto it = buckets.find(key);
+    if ( it == buckets.end() ) {
+        it = buckets.emplace(key, bucket_t{limit.burst, now}).first;
+    }
+    refill(it->second, limit, now);
+    return it->second;
+}
+
+tai_admission_t TAIAdmission::admit(const std::string& peer, const std::set<tai_object_id_t>& modules) {
+    auto limits_peer = m_policy.peer.rate > 0;
+    auto limits_module = m_policy.module.rate > 0 && !modules.empty();
+    if ( !limits_peer && !limits_module ) {
+        return TAI_ADMISSION_ADMITTED;
+    }
+    auto now = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lk(m_mtx);
+    // every bucket is checked before any token is taken. the buckets are pruned first, so that
+    // the references stay valid while the tokens are taken
+    std::vector<bucket_t*> buckets;
+    if ( limits_peer ) {
+        prune(m_peers, m_policy.peer, now);
+        auto& b = find(m_peers, peer, m_policy.peer, now);
+        if ( b.tokens < 1 ) {
+            m_stats.rejected_peer++;
+            return TAI_ADMISSION_REJECTED_PEER;
+        }
+        buckets.emplace_back(&b);
+    }
+    if ( limits_module ) {
+        prune(m_modules, m_policy.module, now);
+        for ( auto mid : modules ) {
+            auto& b = find(m_modules, mid, m_policy.module, now);
+            if ( b.tokens < 1 ) {
+                m_stats.rejected_module++;
+                return TAI_ADMISSION_REJECTED_MODULE;
+            }
+            buckets.emplace_back(&b);
+        }
+    }
+    for ( auto b : buckets ) {
+        b->tokens -= 1;
+    }
+    return TAI_ADMISSION_ADMITTED;
+}
+
+void TAIAdmission::forget_module(tai_object_id_t mid) {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    m_modules.erase(mid);
+}
@@ -0,0 +1,451 @@
+/**
+ * @file    async.cpp
+ *
+ * @brief   This module implements TAI gRPC server with the async gRPC API
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include "taigrpc.hpp"
+#include "worker.hpp"
+#include <grpcpp/alarm.h>
+
+using grpc::Status;
+using grpc::StatusCode;
+using grpc::ServerContext;
+using grpc::ServerCompletionQueue;
+using grpc::CompletionQueue;
+using grpc::ServerAsyncResponseWriter;
+using grpc::ServerAsyncWriter;
+
+using AsyncService = taish::TAI::AsyncService;
+
+// every tag passed to the completion queues is a TAIAsyncCall::tag
+class TAIAsyncCall {
+    public:
+        struct tag {
+            TAIAsyncCall* call;
+            int event;
+        };
+        virtual ~TAIAsyncCall() {}
+        virtual void proceed(int event, bool ok) = 0;
+    protected:
+        enum {
+            EVENT_REQUEST,
+            EVENT_WRITE,
+            EVENT_FINISH,
+            EVENT_WAKEUP,
+            EVENT_DONE,
+        };
+        TAIAsyncCall(TAIAsyncServiceImpl* server, ServerCompletionQueue* cq) : m_server(server), m_cq(cq) {}
+        TAIAsyncServiceImpl* m_server;
+        ServerCompletionQueue* m_cq;
+        ServerContext m_ctx;
+        tag m_request_tag{this, EVENT_REQUEST};
+        tag m_write_tag{this, EVENT_WRITE};
+        tag m_finish_tag{this, EVENT_FINISH};
+};
+
+// the done tag is requested so that the handler can call ServerContext::IsCancelled() safely.
+// the call is deleted once both the finish and the done tag are delivered
+template<typename Req, typename Res>
+class TAIUnaryCall : public TAIAsyncCall {
+    public:
+        using request_fn = void (AsyncService::*)(ServerContext*, Req*, ServerAsyncResponseWriter<Res>*, CompletionQueue*, ServerCompletionQueue*, void*);
+        using handler_fn = Status (TAIServiceImpl::*)(ServerContext*, const Req*, Res*);
+
+        TAIUnaryCall(TAIAsyncServiceImpl* server, ServerCompletionQueue* cq, request_fn request, handler_fn handler) : TAIAsyncCall(server, cq), m_request(request), m_handler(handler), m_responder(&m_ctx) {
+            m_ctx.AsyncNotifyWhenDone(&m_done_tag);
+            (server->service()->*request)(&m_ctx, &m_req, &m_responder, cq, cq, &m_request_tag);
+        }
+
+        // the events of a call are delivered by the poller of its completion queue one at a time
+        void proceed(int event, bool ok) {
+            switch (event) {
+            case EVENT_REQUEST:
+                if ( !ok ) {
+                    // the done tag is never delivered for a call which didn't start
+                    delete this;
+                    return;
+                }
+                new TAIUnaryCall(m_server, m_cq, m_request, m_handler);
+                if ( m_server->workers()->push([this]() {
+                    auto status = (m_server->handler()->*m_handler)(&m_ctx, &m_req, &m_res);
+                    m_responder.Finish(m_res, status, &m_finish_tag);
+                }) < 0 ) {
+                    m_responder.FinishWithError(Status(StatusCode::UNAVAILABLE, "shutting down"), &m_finish_tag);
+                }
+                return;
+            case EVENT_FINISH:
+                m_finished = true;
+                break;
+            case EVENT_DONE:
+                m_done = true;
+                break;
+            }
+            if ( m_finished && m_done ) {
+                delete this;
+            }
+        }
+    private:
+        request_fn m_request;
+        handler_fn m_handler;
+        Req m_req;
+        Res m_res;
+        ServerAsyncResponseWriter<Res> m_responder;
+        tag m_done_tag{this, EVENT_DONE};
+        bool m_finished = false;
+        bool m_done = false;
+};
+
+// server streaming RPCs which return a finite list (ListModule, ListAttributeMetadata).
+// the call is deleted once both the finish and the done tag are delivered, as TAIUnaryCall
+template<typename Req, typename Res>
+class TAIListCall : public TAIAsyncCall {
+    public:
+        using request_fn = void (AsyncService::*)(ServerContext*, Req*, ServerAsyncWriter<Res>*, CompletionQueue*, ServerCompletionQueue*, void*);
+        using handler_fn = Status (TAIServiceImpl::*)(ServerContext*, const Req*, std::function<bool(const Res&)>);
+
+        TAIListCall(TAIAsyncServiceImpl* server, ServerCompletionQueue* cq, request_fn request, handler_fn handler) : TAIAsyncCall(server, cq), m_request(request), m_handler(handler), m_writer(&m_ctx) {
+            m_ctx.AsyncNotifyWhenDone(&m_done_tag);
+            (server->service()->*request)(&m_ctx, &m_req, &m_writer, cq, cq, &m_request_tag);
+        }
+
+        void proceed(int event, bool ok) {
+            switch (event) {
+            case EVENT_REQUEST:
+                if ( !ok ) {
+                    // the done tag is never delivered for a call which didn't start
+                    delete this;
+                    return;
+                }
+                new TAIListCall(m_server, m_cq, m_request, m_handler);
+                if ( m_server->workers()->push([this]() {
+                    m_status = (m_server->handler()->*m_handler)(&m_ctx, &m_req, [&](const Res& res) -> bool {
+                        m_list.emplace_back(res);
+                        return true;
+                    });
+                    next();
+                }) < 0 ) {
+                    m_writer.Finish(Status(StatusCode::UNAVAILABLE, "shutting down"), &m_finish_tag);
+                }
+                return;
+            case EVENT_WRITE:
+                if ( !ok ) {
+                    m_index = m_list.size();
+                }
+                next();
+                return;
+            case EVENT_FINISH:
+                m_finished = true;
+                break;
+            case EVENT_DONE:
+                m_done = true;
+                break;
+            }
+            if ( m_finished && m_done ) {
+                delete this;
+            }
+        }
+    private:
+        void next() {
+            if ( m_index < m_list.size() ) {
+                m_writer.Write(m_list[m_index++], &m_write_tag);
+                return;
+            }
+            m_writer.Finish(m_status, &m_finish_tag);
+        }
+        request_fn m_request;
+        handler_fn m_handler;
+        Req m_req;
+        ServerAsyncWriter<Res> m_writer;
+        Status m_status;
+        std::vector<Res> m_list;
+        size_t m_index = 0;
+        tag m_done_tag{this, EVENT_DONE};
+        bool m_finished = false;
+        bool m_done = false;
+};
+
+// endless server streaming RPCs which deliver the responses queued in State::subscription
+// (Monitor, Subscribe, WatchTopology). the stream is driven by the queue instead of pinning a thread.
+// m_pending counts the outstanding completion queue events and worker tasks.
+// the call is deleted once the client is gone (EVENT_DONE) and nothing is pending
+template<typename Req, typename State, typename Res = taish::MonitorResponse>
+class TAIStreamCall : public TAIAsyncCall {
+    public:
+        using request_fn = void (AsyncService::*)(ServerContext*, Req*, ServerAsyncWriter<Res>*, CompletionQueue*, ServerCompletionQueue*, void*);
+        using start_fn = Status (TAIServiceImpl::*)(ServerContext*, const Req*, State*);
+        using stop_fn = Status (TAIServiceImpl::*)(ServerContext*, State*);
+        // returns false when the stream must end. can be nullptr
+        using alive_fn = bool (TAIServiceImpl::*)(const State*);
+
+        TAIStreamCall(TAIAsyncServiceImpl* server, ServerCompletionQueue* cq, request_fn request, start_fn start, stop_fn stop, alive_fn alive) : TAIAsyncCall(server, cq), m_request(request), m_start(start), m_stop(stop), m_alive(alive), m_writer(&m_ctx) {
+            m_ctx.AsyncNotifyWhenDone(&m_done_tag);
+            (server->service()->*request)(&m_ctx, &m_req, &m_writer, cq, cq, &m_request_tag);
+        }
+
+        void proceed(int event, bool ok) {
+            std::unique_lock<std::mutex> lk(m_mtx);
+            switch (event) {
+            case EVENT_REQUEST:
+                if ( !ok ) {
+                    // the done tag is never delivered for a call which didn't start
+                    lk.unlock();
+                    delete this;
+                    return;
+                }
+                new TAIStreamCall(m_server, m_cq, m_request, m_start, m_stop, m_alive);
+                m_pending++; // EVENT_DONE
+                m_state.subscription.wakeup = [this]() {
+                    wakeup();
+                };
+                m_pending++;
+                if ( m_server->workers()->push([this]() {
+                    auto status = (m_server->handler()->*m_start)(&m_ctx, &m_req, &m_state);
+                    std::unique_lock<std::mutex> lk(m_mtx);
+                    m_pending--;
+                    if ( !m_state.subscribed() ) {
+                        finish(status);
+                    } else {
+                        m_streaming = true;
+                    }
+                    lk.unlock();
+                    write_next();
+                    lk.lock();
+                    settle(lk);
+                }) < 0 ) {
+                    m_pending--;
+                }
+                return;
+            case EVENT_WAKEUP:
+                m_pending--;
+                m_alarm_set = false;
+                lk.unlock();
+                if ( ok ) {
+                    write_next();
+                }
+                lk.lock();
+                break;
+            case EVENT_WRITE:
+                m_pending--;
+                m_writing = false;
+                if ( !ok ) {
+                    m_streaming = false;
+                    break;
+                }
+                lk.unlock();
+                write_next();
+                lk.lock();
+                break;
+            case EVENT_FINISH:
+                m_pending--;
+                break;
+            case EVENT_DONE:
+                m_pending--;
+                m_done = true;
+                m_streaming = false;
+                break;
+            }
+            settle(lk);
+        }
+
+    private:
+        void wakeup() {
+            std::unique_lock<std::mutex> lk(m_mtx);
+            if ( !m_streaming || m_done ) {
+                return;
+            }
+            if ( m_writing ) {
+                m_kicked = true;
+                return;
+            }
+            if ( !m_alarm_set ) {
+                m_alarm_set = true;
+                m_pending++;
+                m_alarm.Set(m_cq, std::chrono::system_clock::now(), &m_wakeup_tag);
+            }
+        }
+
+        // must be called without holding m_mtx since it takes the handler's locks
+        void write_next() {
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lk(m_mtx);
+                    if ( !m_streaming || m_finishing || m_done ) {
+                        return;
+                    }
+                    if ( m_writing ) {
+                        m_kicked = true;
+                        return;
+                    }
+                    m_writing = true;
+                    m_kicked = false;
+                }
+
+                // m_batch is only touched by the one who set m_writing
+                if ( m_batch_index == m_batch.size() ) {
+                    m_batch.clear();
+                    m_batch_index = 0;
+                    auto handler = m_server->handler();
+                    if ( m_alive != nullptr && !(handler->*m_alive)(&m_state) ) {
+                        std::unique_lock<std::mutex> lk(m_mtx);
+                        m_writing = false;
+                        m_streaming = false;
+                        m_removed = true;
+                        finish(Status(StatusCode::UNKNOWN, "object is removed"));
+                        return;
+                    }
+                    // drain everything queued so far and write it out back to back
+                    handler->pop_notifications(&m_state.subscription, &m_batch);
+                }
+
+                std::unique_lock<std::mutex> lk(m_mtx);
+                if ( m_batch_index < m_batch.size() ) {
+                    m_pending++;
+                    m_writer.Write(*m_batch[m_batch_index++], &m_write_tag);
+                    return;
+                }
+                m_writing = false;
+                if ( !m_kicked ) {
+                    return;
+                }
+            }
+        }
+
+        // m_mtx must be held
+        void finish(const Status& status) {
+            if ( m_finishing ) {
+                return;
+            }
+            m_finishing = true;
+            m_pending++;
+            m_writer.Finish(status, &m_finish_tag);
+        }
+
+        // m_mtx must be held. unsubscribes and deletes the call once the client is gone
+        void settle(std::unique_lock<std::mutex>& lk) {
+            if ( !m_done ) {
+                return;
+            }
+            if ( m_alarm_set && !m_alarm_cancelled ) {
+                m_alarm_cancelled = true;
+                m_alarm.Cancel();
+            }
+            if ( m_state.subscribed() && !m_stopping && !m_removed ) {
+                m_stopping = true;
+                m_pending++;
+                if ( m_server->workers()->push([this]() {
+                    (m_server->handler()->*m_stop)(&m_ctx, &m_state);
+                    std::unique_lock<std::mutex> lk(m_mtx);
+                    m_pending--;
+                    settle(lk);
+                }) < 0 ) {
+                    m_pending--;
+                }
+            }
+            if ( m_pending == 0 ) {
+                lk.unlock();
+                delete this;
+            }
+        }
+
+        request_fn m_request;
+        start_fn m_start;
+        stop_fn m_stop;
+        alive_fn m_alive;
+        Req m_req;
+        ServerAsyncWriter<Res> m_writer;
+        State m_state;
+        std::vector<std::shared_ptr<const Res>> m_batch; // drained responses not written yet
+        size_t m_batch_index = 0;
+        grpc::Alarm m_alarm;
+        tag m_wakeup_tag{this, EVENT_WAKEUP};
+        tag m_done_tag{this, EVENT_DONE};
+
+        std::mutex m_mtx;
+        int m_pending = 0;
+        bool m_streaming = false;
+        bool m_writing = false;
+        bool m_kicked = false;
+        bool m_finishing = false;
+        bool m_alarm_set = false;
+        bool m_alarm_cancelled = false;
+        bool m_done = false;
+        bool m_stopping = false;
+        bool m_removed = false;
+};
+
+TAIAsyncServiceImpl::TAIAsyncServiceImpl(TAIServiceImpl* handler, int num_pollers, int num_workers) : m_handler(handler), m_num_pollers(num_pollers < 1 ? 1 : num_pollers), m_workers(new TAIWorkerPool(num_workers)) {}
+
+TAIAsyncServiceImpl::~TAIAsyncServiceImpl() {
+    shutdown();
+}
+
+int TAIAsyncServiceImpl::register_service(::grpc::ServerBuilder& builder) {
+    if ( m_cqs.size() > 0 ) {
+        return -1;
+    }
+    builder.RegisterService(&m_service);
+    for ( int i = 0; i < m_num_pollers; i++ ) {
+        m_cqs.emplace_back(builder.AddCompletionQueue());
+    }
+    return 0;
+}
+
+void TAIAsyncServiceImpl::request_calls(ServerCompletionQueue* cq) {
+    new TAIListCall<taish::ListModuleRequest, taish::ListModuleResponse>(this, cq, &AsyncService::RequestListModule, &TAIServiceImpl::list_module);
+    new TAIListCall<taish::ListAttributeMetadataRequest, taish::ListAttributeMetadataResponse>(this, cq, &AsyncService::RequestListAttributeMetadata, &TAIServiceImpl::list_attribute_metadata);
+    new TAIUnaryCall<taish::GetAttributeMetadataRequest, taish::GetAttributeMetadataResponse>(this, cq, &AsyncService::RequestGetAttributeMetadata, &TAIServiceImpl::GetAttributeMetadata);
+    new TAIUnaryCall<taish::GetAttributeRequest, taish::GetAttributeResponse>(this, cq, &AsyncService::RequestGetAttribute, &TAIServiceImpl::GetAttribute);
+    new TAIUnaryCall<taish::GetAttributeCapabilityRequest, taish::GetAttributeCapabilityResponse>(this, cq, &AsyncService::RequestGetAttributeCapability, &TAIServiceImpl::GetAttributeCapability);
+    new TAIUnaryCall<taish::SetAttributeRequest, taish::SetAttributeResponse>(this, cq, &AsyncService::RequestSetAttribute, &TAIServiceImpl::SetAttribute);
+    new TAIUnaryCall<taish::ClearAttributeRequest, taish::ClearAttributeResponse>(this, cq, &AsyncService::RequestClearAttribute, &TAIServiceImpl::ClearAttribute);
+    new TAIStreamCall<taish::MonitorRequest, tai_monitor_t>(this, cq, &AsyncService::RequestMonitor, &TAIServiceImpl::start_monitor, &TAIServiceImpl::stop_monitor, &TAIServiceImpl::is_monitoring);
+    new TAIUnaryCall<taish::SetLogLevelRequest, taish::SetLogLevelResponse>(this, cq, &AsyncService::RequestSetLogLevel, &TAIServiceImpl::SetLogLevel);
+    new TAIUnaryCall<taish::CreateRequest, taish::CreateResponse>(this, cq, &AsyncService::RequestCreate, &TAIServiceImpl::Create);
+    new TAIUnaryCall<taish::RemoveRequest, taish::RemoveResponse>(this, cq, &AsyncService::RequestRemove, &TAIServiceImpl::Remove);
+    new TAIUnaryCall<taish::BulkGetAttributeRequest, taish::BulkGetAttributeResponse>(this, cq, &AsyncService::RequestBulkGetAttribute, &TAIServiceImpl::BulkGetAttribute);
+    new TAIUnaryCall<taish::GetStatsRequest, taish::GetStatsResponse>(this, cq, &AsyncService::RequestGetStats, &TAIServiceImpl::GetStats);
+    new TAIStreamCall<taish::SubscribeRequest, tai_telemetry_t>(this, cq, &AsyncService::RequestSubscribe, &TAIServiceImpl::start_subscribe, &TAIServiceImpl::stop_subscribe, &TAIServiceImpl::is_sampling);
+    new TAIUnaryCall<taish::ProvisionRequest, taish::ProvisionResponse>(this, cq, &AsyncService::RequestProvision, &TAIServiceImpl::Provision);
+    new TAIStreamCall<taish::WatchTopologyRequest, tai_topology_watch_t, taish::WatchTopologyResponse>(this, cq, &AsyncService::RequestWatchTopology, &TAIServiceImpl::start_watch_topology, &TAIServiceImpl::stop_watch_topology, nullptr);
+}
+
+void TAIAsyncServiceImpl::poll(ServerCompletionQueue* cq) {
+    void* tag;
+    bool ok;
+    while ( cq->Next(&tag, &ok) ) {
+        auto t = static_cast<TAIAsyncCall::tag*>(tag);
+        t->call->proceed(t->event, ok);
+    }
+}
+
+int TAIAsyncServiceImpl::start() {
+    if ( m_cqs.size() == 0 || m_pollers.size() > 0 ) {
+        return -1;
+    }
+    for ( auto& cq : m_cqs ) {
+        request_calls(cq.get());
+        m_pollers.emplace_back(&TAIAsyncServiceImpl::poll, this, cq.get());
+    }
+    return 0;
+}
+
+// the grpc::Server must be shutdown before calling this
+int TAIAsyncServiceImpl::shutdown() {
+    m_workers->stop();
+    for ( auto& cq : m_cqs ) {
+        cq->Shutdown();
+    }
+    for ( auto& t : m_pollers ) {
+        t.join();
+    }
+    m_pollers.clear();
+    return 0;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file    cache.cpp
+ *
+ * @brief   This module implements the attribute read cache of TAI gRPC server
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "taigrpc.hpp"
+
+using namespace std::chrono;
+
+milliseconds TAIAttributeCache::max_age(const tai_attr_metadata_t* const meta) {
+    auto it = m_max_age.find(meta);
+    if ( it != m_max_age.end() ) {
+        return it->second;
+    }
+    milliseconds v(0);
+    auto p = m_policy.find(std::make_pair(meta->objecttype, std::string(meta->attridshortname)));
+    if ( p != m_policy.end() ) {
+        v = p->second;
+    }
+    m_max_age[meta] = v;
+    return v;
+}
+
+tai::S_Attribute TAIAttributeCache::get(tai_object_id_t oid, const tai_attr_metadata_t* const meta) {
+    if ( m_policy.empty() || meta == nullptr ) {
+        return nullptr;
+    }
+    std::unique_lock<std::mutex> lk(m_mtx);
+    if ( max_age(meta).count() == 0 ) {
+        return nullptr;
+    }
+    auto it = m_entries.find(std::make_pair(oid, meta->attrid));
+    if ( it == m_entries.end() ) {
+        m_misses++;
+        return nullptr;
+    }
+    if ( it->second.expire < steady_clock::now() ) {
+        m_stale++;
+        m_misses++;
+        m_entries.erase(it);
+        return nullptr;
+    }
+    m_hits++;
+    return it->second.attr;
+}
+
+void TAIAttributeCache::put(tai_object_id_t oid, const tai_attr_metadata_t* const meta, tai::S_Attribute attr, uint64_t generation) {
+    if ( m_policy.empty() || meta == nullptr || attr == nullptr ) {
+        return;
+    }
+    std::unique_lock<std::mutex> lk(m_mtx);
+    auto age = max_age(meta);
+    // the value may be older than an invalidation which happened while reading it
+    if ( age.count() == 0 || generation != m_generation ) {
+        return;
+    }
+    m_entries[std::make_pair(oid, meta->attrid)] = entry_t{attr, steady_clock::now() + age};
+}
+
+void TAIAttributeCache::invalidate(tai_object_id_t oid, tai_attr_id_t id) {
+    if ( m_policy.empty() ) {
+        return;
+    }
+    std::unique_lock<std::mutex> lk(m_mtx);
+    m_generation++;
+    if ( m_entries.erase(std::make_pair(oid, id)) > 0 ) {
+        m_invalidations++;
+    }
+}
+
+void TAIAttributeCache::invalidate(tai_object_id_t oid) {
+    if ( m_policy.empty() ) {
+        return;
+    }
+    std::unique_lock<std::mutex> lk(m_mtx);
+    m_generation++;
+    auto it = m_entries.lower_bound(std::make_pair(oid, static_cast<tai_attr_id_t>(0)));
+    while ( it != m_entries.end() && it->first.first == oid ) {
+        it = m_entries.erase(it);
+        m_invalidations++;
+    }
+}
+
+void TAIAttributeCache::clear() {
+    if ( m_policy.empty() ) {
+        return;
+    }
+    std::unique_lock<std::mutex> lk(m_mtx);
+    m_generation++;
+    m_invalidations += m_entries.size();
+    m_entries.clear();
+    // the metadata of the removed objects may be freed and its address reused
+    m_max_age.clear();
+}
+
+tai_cache_stats_t TAIAttributeCache::stats() {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    return tai_cache_stats_t{
+        .hits = m_hits,
+        .misses = m_misses,
+        .stale = m_stale,
+        .invalidations = m_invalidations,
+        .entries = m_entries.size(),
+    };
+}
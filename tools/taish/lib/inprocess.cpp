@@ -0,0 +1,48 @@
+/**
+ * @file    inprocess.cpp
+ *
+ * @brief   This module implements the in-process TAI gRPC server
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "taigrpc.hpp"
+
+TAIInProcessServer::~TAIInProcessServer() {
+    shutdown();
+}
+
+int TAIInProcessServer::start() {
+    if ( m_server != nullptr ) {
+        return -1;
+    }
+    ::grpc::ServerBuilder builder;
+    for ( auto& addr : m_addrs ) {
+        builder.AddListeningPort(addr, ::grpc::InsecureServerCredentials());
+    }
+    builder.RegisterService(m_handler);
+    m_server = builder.BuildAndStart();
+    return m_server == nullptr ? -1 : 0;
+}
+
+int TAIInProcessServer::shutdown() {
+    if ( m_server == nullptr ) {
+        return 0;
+    }
+    // cancels the open streams instead of waiting for them
+    m_server->Shutdown(std::chrono::system_clock::now());
+    m_server->Wait();
+    m_server.reset();
+    return 0;
+}
+
+std::shared_ptr<::grpc::Channel> TAIInProcessServer::channel() {
+    if ( m_server == nullptr ) {
+        return nullptr;
+    }
+    return m_server->InProcessChannel(::grpc::ChannelArguments());
+}
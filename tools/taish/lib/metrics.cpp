@@ -0,0 +1,136 @@
+/**
+ * @file    metrics.cpp
+ *
+ * @brief   This module implements the metrics of TAI gRPC server
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "taigrpc.hpp"
+#include <sstream>
+
+void tai_histogram_t::observe(uint64_t v) {
+    size_t i = v <= 1 ? 0 : 64 - __builtin_clzll(v - 1);
+    if ( i > NUM_BUCKETS ) {
+        i = NUM_BUCKETS;
+    }
+    buckets[i]++;
+    count++;
+    sum += v;
+}
+
+tai_histogram_t* TAIMetrics::histogram(const std::string& name, const std::string& label, tai_object_type_t type, tai_attr_id_t id) {
+    auto key = std::make_tuple(name, label, type, id);
+    {
+        std::shared_lock<std::shared_mutex> lk(m_mtx);
+        auto it = m_histograms.find(key);
+        if ( it != m_histograms.end() ) {
+            return it->second.get();
+        }
+    }
+    std::unique_lock<std::shared_mutex> lk(m_mtx);
+    auto& h = m_histograms[key];
+    if ( h == nullptr ) {
+        h = std::make_unique<tai_histogram_t>();
+    }
+    return h.get();
+}
+
+void TAIMetrics::snapshot(taish::GetStatsResponse* res) {
+    std::shared_lock<std::shared_mutex> lk(m_mtx);
+    for ( auto& v : m_histograms ) {
+        auto h = res->add_histograms();
+        h->set_name(std::get<0>(v.first));
+        h->set_label(std::get<1>(v.first));
+        h->set_object_type(static_cast<taish::TAIObjectType>(std::get<2>(v.first)));
+        h->set_attr_id(std::get<3>(v.first));
+        for ( size_t i = 0; i <= tai_histogram_t::NUM_BUCKETS; i++ ) {
+            if ( i < tai_histogram_t::NUM_BUCKETS ) {
+                h->add_bounds(uint64_t(1) << i);
+            }
+            h->add_counts(v.second->buckets[i]);
+        }
+        h->set_count(v.second->count);
+        h->set_sum(v.second->sum);
+    }
+}
+
+// e.g. cache.hits -> taish_cache_hits
+static std::string metric_name(const std::string& name) {
+    auto v = "taish_" + name;
+    for ( auto& c : v ) {
+        if ( !isalnum(c) ) {
+            c = '_';
+        }
+    }
+    return v;
+}
+
+std::string TAIServiceImpl::stats_text() {
+    taish::GetStatsResponse res;
+    collect_stats(&res);
+
+    // the label name of each histogram family
+    static const std::map<std::string, std::string> label_names = {
+        {"rpc_latency_us", "method"},
+        {"adapter_latency_us", "op"},
+        {"lock_wait_us", "lock"},
+        {"queue_wait_us", "class"},
+    };
+    static const std::map<int, std::string> type_names = {
+        {taish::MODULE, "module"},
+        {taish::HOSTIF, "hostif"},
+        {taish::NETIF, "netif"},
+    };
+
+    std::stringstream ss;
+    std::map<std::string, uint64_t> counters(res.counters().begin(), res.counters().end());
+    for ( auto& c : counters ) {
+        auto name = metric_name(c.first);
+        ss << "# TYPE " << name << (c.first.find("entries") == std::string::npos ? " counter" : " gauge") << std::endl;
+        ss << name << " " << c.second << std::endl;
+    }
+
+    std::string family;
+    for ( auto& h : res.histograms() ) {
+        auto name = metric_name(h.name());
+        if ( name != family ) {
+            ss << "# TYPE " << name << " histogram" << std::endl;
+            family = name;
+        }
+        std::stringstream labels;
+        if ( h.label() != "" ) {
+            auto l = label_names.find(h.name());
+            labels << (l == label_names.end() ? "label" : l->second) << "=\"" << h.label() << "\",";
+        }
+        auto t = type_names.find(h.object_type());
+        if ( t != type_names.end() ) {
+            labels << "object_type=\"" << t->second << "\",";
+        }
+        if ( h.attr_id() != 0 ) {
+            labels << "attr_id=\"0x" << std::hex << h.attr_id() << std::dec << "\",";
+        }
+        uint64_t cumulative = 0;
+        for ( int i = 0; i < h.counts_size(); i++ ) {
+            cumulative += h.counts(i);
+            ss << name << "_bucket{" << labels.str() << "le=\"";
+            if ( i < h.bounds_size() ) {
+                ss << h.bounds(i);
+            } else {
+                ss << "+Inf";
+            }
+            ss << "\"} " << cumulative << std::endl;
+        }
+        auto l = labels.str();
+        if ( l.size() > 0 ) {
+            l = "{" + l.substr(0, l.size() - 1) + "}";
+        }
+        ss << name << "_sum" << l << " " << h.sum() << std::endl;
+        ss << name << "_count" << l << " " << h.count() << std::endl;
+    }
+    return ss.str();
+}
@@ -0,0 +1,104 @@
+/**
+ * @file    name.cpp
+ *
+ * @brief   This module implements the attribute name resolution of TAI gRPC server
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "name.hpp"
+#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+#include <memory>
+
+struct tai_name_index_t {
+    // the arrays of the metadata the index was built from
+    const int* values;
+    const char* const* valuesnames;
+    const char* const* valuesshortnames;
+    size_t valuescount;
+    // the positions of the names in valuesnames and valuesshortnames
+    std::unordered_map<std::string, size_t> names;
+    std::unordered_map<std::string, size_t> shortnames;
+};
+
+// the enum metadata from meta_api may be freed when a module is removed, and other metadata may
+// take its address. the index is rebuilt when the arrays of the metadata have changed, and a hit
+// is checked against the metadata in case new arrays took the addresses of the old ones too
+static std::unordered_map<const tai_enum_metadata_t*, std::shared_ptr<const tai_name_index_t>> g_indexes;
+static std::shared_mutex g_indexes_mtx;
+
+static std::shared_ptr<const tai_name_index_t> get_index(const tai_enum_metadata_t* const meta, bool rebuild) {
+    auto built_from = [meta](const tai_name_index_t& index) {
+        return index.values == meta->values && index.valuesnames == meta->valuesnames && index.valuesshortnames == meta->valuesshortnames && index.valuescount == meta->valuescount;
+    };
+    if ( !rebuild ) {
+        std::shared_lock<std::shared_mutex> lk(g_indexes_mtx);
+        auto it = g_indexes.find(meta);
+        if ( it != g_indexes.end() && built_from(*it->second) ) {
+            return it->second;
+        }
+    }
+    auto index = std::make_shared<tai_name_index_t>();
+    index->values = meta->values;
+    index->valuesnames = meta->valuesnames;
+    index->valuesshortnames = meta->valuesshortnames;
+    index->valuescount = meta->valuescount;
+    for ( size_t i = 0; i < meta->valuescount; i++ ) {
+        // the first one wins as tai_deserialize_enum() does
+        if ( meta->valuesnames != nullptr ) {
+            index->names.emplace(meta->valuesnames[i], i);
+        }
+        if ( meta->valuesshortnames != nullptr ) {
+            index->shortnames.emplace(meta->valuesshortnames[i], i);
+        }
+    }
+    std::unique_lock<std::shared_mutex> lk(g_indexes_mtx);
+    auto& v = g_indexes[meta];
+    if ( rebuild || v == nullptr || !built_from(*v) ) {
+        v = index;
+    }
+    return v;
+}
+
+int resolve_attr_name(const tai_enum_metadata_t* const meta, const std::string& name, int32_t* attr_id, const tai_serialize_option_t* const option) {
+    if ( meta != nullptr && ( option == nullptr || !option->json ) ) {
+        auto human = option != nullptr && option->human;
+        auto list = human ? meta->valuesshortnames : meta->valuesnames;
+        for ( auto rebuild : {false, true} ) {
+            auto index = get_index(meta, rebuild);
+            auto& names = human ? index->shortnames : index->names;
+            auto it = names.find(name);
+            if ( it == names.end() ) {
+                break;
+            }
+            auto i = it->second;
+            if ( list != nullptr && i < meta->valuescount && name == list[i] ) {
+                *attr_id = meta->values[i];
+                return name.size();
+            }
+        }
+    }
+    return tai_deserialize_enum(name.c_str(), meta, attr_id, option);
+}
+
+int resolve_attr_name(tai_object_type_t type, const std::string& name, int32_t* attr_id, const tai_serialize_option_t* const option) {
+    switch (type) {
+    case TAI_OBJECT_TYPE_MODULE:
+    case TAI_OBJECT_TYPE_NETWORKIF:
+    case TAI_OBJECT_TYPE_HOSTIF:
+        break;
+    default:
+        return TAI_STATUS_NOT_SUPPORTED;
+    }
+    auto info = tai_metadata_all_object_type_infos[type];
+    if ( info == nullptr ) {
+        return TAI_STATUS_NOT_SUPPORTED;
+    }
+    return resolve_attr_name(info->enummetadata, name, attr_id, option);
+}
@@ -0,0 +1,29 @@
+/**
+ * @file    name.hpp
+ *
+ * @brief   This module defines the attribute name resolution of TAI gRPC server
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef __TAISH_NAME_HPP__
+#define __TAISH_NAME_HPP__
+
+#include "tai.h"
+#include "taimetadata.h"
+#include <string>
+
+// same as tai_deserialize_enum() but looks up the name in a hash index which is built
+// once per enum metadata (e.g. tai_object_type_info_t::enummetadata), and again when
+// the metadata at that address has changed.
+// names the index doesn't know (e.g. json strings, numbers) are handed to tai_deserialize_enum()
+int resolve_attr_name(const tai_enum_metadata_t* const meta, const std::string& name, int32_t* attr_id, const tai_serialize_option_t* const option);
+
+// resolves the attribute name of the object type with the metadata generated from the TAI headers
+int resolve_attr_name(tai_object_type_t type, const std::string& name, int32_t* attr_id, const tai_serialize_option_t* const option);
+
+#endif // __TAISH_NAME_HPP__
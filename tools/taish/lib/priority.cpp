@@ -0,0 +1,56 @@
+/**
+ * @file    priority.cpp
+ *
+ * @brief   This module implements the priority mutex of TAI gRPC server
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "taigrpc.hpp"
+
+bool TAIPriorityMutex::try_lock_until(tai_priority_t cls, std::chrono::steady_clock::time_point since, std::chrono::system_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    if ( !m_locked ) {
+        m_locked = true;
+        return true;
+    }
+
+    waiter_t w;
+    arrival_t arrival{since, ++m_seq};
+    m_waiters.emplace(std::make_pair(cls, arrival), &w);
+    m_arrivals.emplace(arrival, cls);
+
+    if ( deadline == std::chrono::system_clock::time_point::max() ) {
+        w.cv.wait(lk, [&]() { return w.granted; });
+        return true;
+    }
+    if ( w.cv.wait_until(lk, deadline, [&]() { return w.granted; }) ) {
+        return true;
+    }
+    m_waiters.erase(std::make_pair(cls, arrival));
+    m_arrivals.erase(arrival);
+    return false;
+}
+
+void TAIPriorityMutex::unlock() {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    if ( m_waiters.empty() ) {
+        m_locked = false;
+        return;
+    }
+    // hand the mutex over to the oldest waiter if it is starving, otherwise to the highest class
+    auto oldest = m_arrivals.begin();
+    auto it = m_waiters.begin();
+    if ( std::chrono::steady_clock::now() - oldest->first.first >= m_max_wait ) {
+        it = m_waiters.find(std::make_pair(oldest->second, oldest->first));
+    }
+    m_arrivals.erase(it->first.second);
+    auto w = it->second;
+    m_waiters.erase(it);
+    w->granted = true;
+    w->cv.notify_one();
+}
@@ -0,0 +1,182 @@
+/**
+ * @file    recorder.cpp
+ *
+ * @brief   This module implements the RPC record log of TAI gRPC server
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "taigrpc.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+// the log is flushed at most once in this interval so that recording doesn't cost a write per RPC
+static const auto TAI_RECORD_FLUSH_INTERVAL = std::chrono::seconds(1);
+
+static void put_varint(std::string& buf, uint64_t v) {
+    while ( v >= 0x80 ) {
+        buf.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    buf.push_back(static_cast<char>(v));
+}
+
+// writes the index of s in table. s follows when this is the first time it appears
+static void put_string(std::string& buf, std::unordered_map<std::string, uint64_t>& table, const std::string& s) {
+    auto it = table.find(s);
+    if ( it != table.end() ) {
+        put_varint(buf, it->second);
+        return;
+    }
+    auto index = table.size();
+    table.emplace(s, index);
+    put_varint(buf, index);
+    put_varint(buf, s.size());
+    buf.append(s);
+}
+
+TAIRecorder::~TAIRecorder() {
+    close();
+}
+
+int TAIRecorder::open(const std::string& path) {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    if ( m_fp != nullptr ) {
+        return -1;
+    }
+    m_fp = fopen(path.c_str(), "wb");
+    if ( m_fp == nullptr ) {
+        return -1;
+    }
+    if ( fwrite(TAI_RECORD_MAGIC, sizeof(TAI_RECORD_MAGIC), 1, m_fp) != 1 ) {
+        fclose(m_fp);
+        m_fp = nullptr;
+        return -1;
+    }
+    fflush(m_fp);
+    m_flushed = std::chrono::steady_clock::now();
+    return 0;
+}
+
+void TAIRecorder::record(const std::string& method, const std::string& peer, const google::protobuf::Message& request) {
+    auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    auto body = request.SerializeAsString();
+
+    std::unique_lock<std::mutex> lk(m_mtx);
+    if ( m_fp == nullptr ) {
+        return;
+    }
+    // the calls are recorded in the order they take m_mtx, which may be slightly off the arrival order
+    uint64_t timestamp = std::max(static_cast<uint64_t>(now), m_last);
+    std::string buf;
+    put_varint(buf, timestamp - m_last);
+    put_string(buf, m_methods, method);
+    put_string(buf, m_peers, peer);
+    put_varint(buf, body.size());
+    buf.append(body);
+    if ( fwrite(buf.data(), buf.size(), 1, m_fp) != 1 ) {
+        return;
+    }
+    m_last = timestamp;
+    m_recorded++;
+
+    auto t = std::chrono::steady_clock::now();
+    if ( t - m_flushed >= TAI_RECORD_FLUSH_INTERVAL ) {
+        fflush(m_fp);
+        m_flushed = t;
+    }
+}
+
+void TAIRecorder::close() {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    if ( m_fp != nullptr ) {
+        fclose(m_fp);
+        m_fp = nullptr;
+    }
+}
+
+TAIRecordReader::~TAIRecordReader() {
+    if ( m_fp != nullptr ) {
+        fclose(m_fp);
+    }
+}
+
+int TAIRecordReader::open(const std::string& path) {
+    if ( m_fp != nullptr ) {
+        return -1;
+    }
+    m_fp = fopen(path.c_str(), "rb");
+    if ( m_fp == nullptr ) {
+        return -1;
+    }
+    char magic[sizeof(TAI_RECORD_MAGIC)];
+    if ( fread(magic, sizeof(magic), 1, m_fp) != 1 || memcmp(magic, TAI_RECORD_MAGIC, sizeof(magic)) != 0 ) {
+        fclose(m_fp);
+        m_fp = nullptr;
+        return -1;
+    }
+    return 0;
+}
+
+// returns false when the log ends before the first byte
+bool TAIRecordReader::read_varint(uint64_t* v) {
+    *v = 0;
+    for ( int shift = 0; shift < 64; shift += 7 ) {
+        auto c = fgetc(m_fp);
+        if ( c == EOF ) {
+            if ( shift == 0 ) {
+                return false;
+            }
+            throw std::runtime_error("truncated varint");
+        }
+        *v |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if ( (c & 0x80) == 0 ) {
+            return true;
+        }
+    }
+    throw std::runtime_error("invalid varint");
+}
+
+std::string TAIRecordReader::read_string(std::vector<std::string>* table) {
+    uint64_t index, size;
+    if ( !read_varint(&index) ) {
+        throw std::runtime_error("truncated record");
+    }
+    if ( index < table->size() ) {
+        return (*table)[index];
+    }
+    if ( index != table->size() || !read_varint(&size) ) {
+        throw std::runtime_error("invalid string index");
+    }
+    std::string s(size, '\0');
+    if ( size > 0 && fread(&s[0], size, 1, m_fp) != 1 ) {
+        throw std::runtime_error("truncated string");
+    }
+    table->emplace_back(s);
+    return s;
+}
+
+bool TAIRecordReader::next(tai_recorded_call_t* call) {
+    uint64_t delta, size;
+    if ( m_fp == nullptr || !read_varint(&delta) ) {
+        return false;
+    }
+    call->timestamp = m_last + delta;
+    call->method = read_string(&m_methods);
+    call->peer = read_string(&m_peers);
+    if ( !read_varint(&size) ) {
+        throw std::runtime_error("truncated record");
+    }
+    call->request.resize(size);
+    if ( size > 0 && fread(&call->request[0], size, 1, m_fp) != 1 ) {
+        throw std::runtime_error("truncated request");
+    }
+    m_last = call->timestamp;
+    return true;
+}
@@ -0,0 +1,200 @@
+/**
+ * @file    sampler.cpp
+ *
+ * @brief   This module implements the attribute sampler of TAI gRPC server
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "taigrpc.hpp"
+#include <set>
+#include <algorithm>
+
+using namespace std::chrono;
+
+TAISampler::~TAISampler() {
+    {
+        std::unique_lock<std::mutex> lk(m_mtx);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    if ( m_thread.joinable() ) {
+        m_thread.join();
+    }
+}
+
+void TAISampler::add(tai_telemetry_t* t) {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    auto seq = ++m_seq;
+    m_streams[t] = seq;
+    for ( size_t i = 0; i < t->paths.size(); i++ ) {
+        schedule(entry_t{t, i, 0, seq}, 1);
+    }
+    if ( !m_thread.joinable() ) {
+        m_thread = std::thread(&TAISampler::run, this);
+    }
+    m_cv.notify_all();
+}
+
+void TAISampler::remove(tai_telemetry_t* t) {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    m_streams.erase(t);
+    for ( auto& slot : m_wheel ) {
+        for ( auto it = slot.begin(); it != slot.end(); ) {
+            if ( it->t == t ) {
+                it = slot.erase(it);
+                m_size--;
+            } else {
+                it++;
+            }
+        }
+    }
+}
+
+void TAISampler::object_removed(tai_object_id_t oid) {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    std::set<tai_telemetry_t*> removed;
+    for ( auto& slot : m_wheel ) {
+        for ( auto& e : slot ) {
+            auto& p = e.t->paths[e.index];
+            if ( p.oid == oid || p.module == oid ) {
+                removed.insert(e.t);
+            }
+        }
+    }
+    if ( removed.empty() ) {
+        return;
+    }
+    // the stream ends, so none of its paths is read any more
+    for ( auto& slot : m_wheel ) {
+        for ( auto it = slot.begin(); it != slot.end(); ) {
+            if ( removed.count(it->t) > 0 ) {
+                it = slot.erase(it);
+                m_size--;
+            } else {
+                it++;
+            }
+        }
+    }
+    // m_mtx keeps t alive until the wakeup is delivered since remove() takes it
+    for ( auto t : removed ) {
+        t->removed = true;
+        auto& s = t->subscription;
+        {
+            std::unique_lock<std::mutex> slk(s.mtx);
+            s.cv.notify_one();
+        }
+        if ( s.wakeup ) {
+            s.wakeup();
+        }
+    }
+}
+
+void TAISampler::schedule(const entry_t& e, uint64_t ticks) {
+    auto n = m_wheel.size();
+    auto v = e;
+    v.rounds = (ticks - 1) / n;
+    m_wheel[(m_tick + ticks) % n].emplace_back(v);
+    m_size++;
+}
+
+void TAISampler::sample(const std::vector<entry_t>& due, std::unique_lock<std::mutex>& lk) {
+    // paths subscribed by multiple streams are read once
+    std::map<tai_object_id_t, std::set<tai_attr_id_t>> ids;
+    for ( auto& e : due ) {
+        auto& p = e.t->paths[e.index];
+        ids[p.oid].insert(p.id);
+    }
+    std::map<tai_object_id_t, std::vector<tai_attr_id_t>> objects;
+    for ( auto& o : ids ) {
+        objects[o.first].assign(o.second.begin(), o.second.end());
+    }
+
+    // add() and remove() aren't blocked by a slow adapter
+    std::map<tai_object_id_t, std::vector<tai::S_Attribute>> values;
+    lk.unlock();
+    m_handler->read_attributes(objects, &values);
+    lk.lock();
+
+    // one notification per stream and object
+    std::map<std::pair<tai_telemetry_t*, tai_object_id_t>, tai_notification_t> notifications;
+    for ( auto& e : due ) {
+        auto it = m_streams.find(e.t);
+        if ( it == m_streams.end() || it->second != e.seq || e.t->removed ) {
+            continue;
+        }
+        auto& p = e.t->paths[e.index];
+        auto& list = objects[p.oid];
+        auto i = std::lower_bound(list.begin(), list.end(), p.id) - list.begin();
+        auto attr = values[p.oid][i];
+        if ( attr == nullptr ) {
+            continue;
+        }
+        if ( p.on_change ) {
+            auto v = attr->to_string(nullptr);
+            if ( v == p.last ) {
+                continue;
+            }
+            p.last = v;
+        }
+        auto& n = notifications[std::make_pair(e.t, p.oid)];
+        n.oid = p.oid;
+        n.attrs.emplace_back(attr);
+    }
+
+    for ( auto& v : notifications ) {
+        auto& s = v.first.first->subscription;
+        {
+            std::unique_lock<std::mutex> lk(s.mtx);
+            s.push(v.second);
+            s.cv.notify_one();
+        }
+        if ( s.wakeup ) {
+            s.wakeup();
+        }
+    }
+}
+
+void TAISampler::run() {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    auto next = steady_clock::now();
+    while ( !m_stop ) {
+        if ( m_size == 0 ) {
+            m_cv.wait(lk, [&]{ return m_stop || m_size > 0; });
+            next = steady_clock::now();
+            continue;
+        }
+        next += m_tick_interval;
+        if ( next < steady_clock::now() - m_tick_interval ) {
+            // fell behind by more than a tick (e.g. slow adapter). skip the missed ticks
+            next = steady_clock::now();
+        }
+        if ( m_cv.wait_until(lk, next, [&]{ return m_stop; }) ) {
+            break;
+        }
+
+        m_tick++;
+        auto& slot = m_wheel[m_tick % m_wheel.size()];
+        std::vector<entry_t> due;
+        for ( auto it = slot.begin(); it != slot.end(); ) {
+            if ( it->rounds > 0 ) {
+                it->rounds--;
+                it++;
+                continue;
+            }
+            due.emplace_back(*it);
+            it = slot.erase(it);
+            m_size--;
+        }
+        for ( auto& e : due ) {
+            schedule(e, e.t->paths[e.index].interval);
+        }
+        if ( due.size() > 0 ) {
+            sample(due, lk);
+        }
+    }
+}
@@ -14,10 +14,14 @@
 #include "taigrpc.hpp"
 #include "taimetadata.h"
 #include <sstream>
+#include <set>
 #include <chrono>
 #include <functional>
+#include <cmath>
 #include "attribute.hpp"
 #include "capability.hpp"
+#include "value.hpp"
+#include "name.hpp"
 
 using grpc::Status;
 using grpc::StatusCode;
@@ -49,15 +53,193 @@ const tai_attr_metadata_t* const get_metadata(tai_meta_api_t* meta_api, const ta
     return tai_metadata_get_attr_metadata(type, attr_id);
 }
 
+// how often a call waiting for the adapter lock checks whether it is cancelled
+static const auto TAI_LOCK_POLL_INTERVAL = std::chrono::milliseconds(10);
+
+template<typename Lock>
+::grpc::Status TAIServiceImpl::acquire(Lock& lk, ::grpc::ServerContext* context) {
+    if ( context == nullptr ) {
+        lk.lock();
+        return Status::OK;
+    }
+    // the deadline is the infinite future when the client didn't set it
+    auto deadline = context->deadline();
+    while ( true ) {
+        // gRPC cancels the call once the deadline passes. count it as expired
+        auto now = std::chrono::system_clock::now();
+        if ( now >= deadline ) {
+            m_shed_expired++;
+            return Status(StatusCode::DEADLINE_EXCEEDED, "deadline exceeded while waiting for the TAI adapter");
+        }
+        if ( context->IsCancelled() ) {
+            m_shed_cancelled++;
+            return Status(StatusCode::CANCELLED, "cancelled while waiting for the TAI adapter");
+        }
+        if ( lk.try_lock_until(std::min(deadline, now + TAI_LOCK_POLL_INTERVAL)) ) {
+            return Status::OK;
+        }
+    }
+}
+
+// lets acquire() wait for the read of another call on behalf of a coalesced call
+class tai_flight_waiter_t {
+    public:
+        tai_flight_waiter_t(const TAISingleFlight::result_t& result) : m_result(result) {}
+        void lock() {
+            m_result.wait();
+        }
+        template<typename T>
+        bool try_lock_until(const T& t) {
+            return m_result.wait_until(t) == std::future_status::ready;
+        }
+    private:
+        const TAISingleFlight::result_t& m_result;
+};
+
+// the locks taken so far are released when the result is shed
+static tai_api_lock_t shed_lock(const ::grpc::Status& status) {
+    tai_api_lock_t lk;
+    lk.status = status;
+    return lk;
+}
+
+static const std::string TAI_PRIORITY_NAMES[TAI_PRIORITY_MAX] = {"control", "get", "metadata"};
+
+// the class given by the "taish-priority" metadata of the call, or cls when it is not given
+static tai_priority_t call_priority(::grpc::ServerContext* context, tai_priority_t cls) {
+    if ( context == nullptr ) {
+        return cls;
+    }
+    auto& md = context->client_metadata();
+    auto it = md.find("taish-priority");
+    if ( it == md.end() ) {
+        return cls;
+    }
+    std::string v(it->second.data(), it->second.size());
+    for ( int i = 0; i < TAI_PRIORITY_MAX; i++ ) {
+        if ( v == TAI_PRIORITY_NAMES[i] ) {
+            return static_cast<tai_priority_t>(i);
+        }
+    }
+    return cls;
+}
+
+tai_api_lock_t TAIServiceImpl::lock_object(tai_object_id_t oid, tai_priority_t cls, ::grpc::ServerContext* context) {
+    tai_api_lock_t lk;
+    cls = call_priority(context, cls);
+    TAIMetricsTimer q(m_metrics.histogram("queue_wait_us", TAI_PRIORITY_NAMES[cls]));
+    if ( !m_module_thread_safe ) {
+        TAIMetricsTimer t(m_metrics.histogram("lock_wait_us", "exclusive"));
+        lk.serial = TAIPriorityLock(&m_serial_mtx, cls);
+        lk.status = acquire(lk.serial, context);
+        return lk;
+    }
+    // the shared lock keeps the module from being removed while we are using it
+    {
+        TAIMetricsTimer t(m_metrics.histogram("lock_wait_us", "shared"));
+        TAIPriorityLock gate(&m_gate, cls);
+        auto status = acquire(gate, context);
+        if ( !status.ok() ) {
+            return shed_lock(status);
+        }
+        lk.shared = std::shared_lock<std::shared_timed_mutex>(m_mtx, std::defer_lock);
+        status = acquire(lk.shared, context);
+        if ( !status.ok() ) {
+            return shed_lock(status);
+        }
+    }
+    auto mid = tai_module_id_query(oid);
+    TAIPriorityMutex* mtx;
+    {
+        std::unique_lock<std::mutex> mlk(m_module_mtxs_mtx);
+        auto& v = m_module_mtxs[mid];
+        if ( !v ) {
+            v = std::make_unique<TAIPriorityMutex>();
+        }
+        mtx = v.get();
+    }
+    TAIMetricsTimer t(m_metrics.histogram("lock_wait_us", "module"));
+    lk.serial = TAIPriorityLock(mtx, cls);
+    auto status = acquire(lk.serial, context);
+    if ( !status.ok() ) {
+        return shed_lock(status);
+    }
+    return lk;
+}
+
+tai_api_lock_t TAIServiceImpl::lock_all(::grpc::ServerContext* context) {
+    tai_api_lock_t lk;
+    TAIMetricsTimer q(m_metrics.histogram("queue_wait_us", TAI_PRIORITY_NAMES[TAI_PRIORITY_CONTROL]));
+    TAIMetricsTimer t(m_metrics.histogram("lock_wait_us", "exclusive"));
+    if ( !m_module_thread_safe ) {
+        lk.serial = TAIPriorityLock(&m_serial_mtx, TAI_PRIORITY_CONTROL);
+        lk.status = acquire(lk.serial, context);
+        return lk;
+    }
+    lk.gate = TAIPriorityLock(&m_gate, TAI_PRIORITY_CONTROL);
+    lk.status = acquire(lk.gate, context);
+    if ( !lk.status.ok() ) {
+        return lk;
+    }
+    lk.exclusive = std::unique_lock<std::shared_timed_mutex>(m_mtx, std::defer_lock);
+    lk.status = acquire(lk.exclusive, context);
+    return lk;
+}
+
+// "ipv4:127.0.0.1:54321" -> "ipv4:127.0.0.1". a client gets a new port for every channel,
+// so the port is not a part of the budget key. other peers (e.g. unix:) are used as is
+static std::string peer_address(const std::string& peer) {
+    if ( peer.compare(0, 5, "ipv4:") != 0 && peer.compare(0, 5, "ipv6:") != 0 ) {
+        return peer;
+    }
+    return peer.substr(0, peer.rfind(':'));
+}
+
+::grpc::Status TAIServiceImpl::admit(::grpc::ServerContext* context, const std::vector<tai_object_id_t>& oids) {
+    std::set<tai_object_id_t> modules;
+    for ( auto oid : oids ) {
+        if ( oid != TAI_NULL_OBJECT_ID ) {
+            modules.insert(tai_module_id_query(oid));
+        }
+    }
+    switch (m_admission.admit(peer_address(context->peer()), modules)) {
+    case TAI_ADMISSION_REJECTED_PEER:
+        return Status(StatusCode::RESOURCE_EXHAUSTED, "too many calls from the peer");
+    case TAI_ADMISSION_REJECTED_MODULE:
+        return Status(StatusCode::RESOURCE_EXHAUSTED, "too many calls to the module");
+    default:
+        return Status::OK;
+    }
+}
+
 ::grpc::Status TAIServiceImpl::ListModule(::grpc::ServerContext* context, const taish::ListModuleRequest* request, ::grpc::ServerWriter< taish::ListModuleResponse>* writer) {
+    return list_module(context, request, [&](const taish::ListModuleResponse& res) -> bool {
+        return writer->Write(res);
+    });
+}
+
+::grpc::Status TAIServiceImpl::list_module(::grpc::ServerContext* context, const taish::ListModuleRequest* request, std::function<bool(const taish::ListModuleResponse&)> write) {
+    // called by the sync and the async server
+    record(context, "ListModule", *request);
+    auto timer = rpc_timer("ListModule");
 
+    // the snapshot is never modified, so it is read without any lock
+    std::shared_ptr<const tai_topology_t> snapshot;
     std::vector<tai_api_module_t> list;
-    auto ret = m_api->list_module(list);
-    if ( ret != TAI_STATUS_SUCCESS ) {
-        goto err;
+    tai_status_t ret = TAI_STATUS_SUCCESS;
+    if ( m_topology != nullptr ) {
+        snapshot = m_topology->snapshot();
+    } else {
+        ret = m_api->list_module(list);
+        if ( ret != TAI_STATUS_SUCCESS ) {
+            goto err;
+        }
     }
-    for ( const auto& module : list ) {
+    for ( const auto& module : snapshot != nullptr ? snapshot->modules : list ) {
         auto res = taish::ListModuleResponse();
+        if ( snapshot != nullptr ) {
+            res.set_version(snapshot->version);
+        }
         auto m = res.mutable_module();
 
         m->set_location(module.location);
@@ -80,7 +262,7 @@ const tai_attr_metadata_t* const get_metadata(tai_meta_api_t* meta_api, const ta
                 netif->set_module_oid(module.id);
             }
         }
-        writer->Write(res);
+        write(res);
     }
 err:
     add_status(context, ret);
@@ -165,7 +347,15 @@ static tai_serialize_option_t convert_serialize_option(const taish::SerializeOpt
 }
 
 ::grpc::Status TAIServiceImpl::ListAttributeMetadata(::grpc::ServerContext* context, const taish::ListAttributeMetadataRequest* request, ::grpc::ServerWriter< taish::ListAttributeMetadataResponse>* writer) {
-    auto res = taish::ListAttributeMetadataResponse();
+    return list_attribute_metadata(context, request, [&](const taish::ListAttributeMetadataResponse& res) -> bool {
+        return writer->Write(res);
+    });
+}
+
+::grpc::Status TAIServiceImpl::list_attribute_metadata(::grpc::ServerContext* context, const taish::ListAttributeMetadataRequest* request, std::function<bool(const taish::ListAttributeMetadataResponse&)> write) {
+    // called by the sync and the async server
+    record(context, "ListAttributeMetadata", *request);
+    auto timer = rpc_timer("ListAttributeMetadata");
     auto object_type = request->object_type();
     auto info = tai_metadata_all_object_type_infos[object_type];
     auto oid = request->oid();
@@ -188,16 +378,55 @@ static tai_serialize_option_t convert_serialize_option(const taish::SerializeOpt
     }
 
     for ( uint32_t i = 0; i < count; i++ ) {
-        auto src = list[i];
-        auto dst = res.mutable_metadata();
-        convert_metadata(src, dst);
-        writer->Write(res);
+        write(*metadata_response(list[i]));
     }
 
     return Status::OK;
 }
 
+std::shared_ptr<const taish::ListAttributeMetadataResponse> TAIServiceImpl::metadata_response(const tai_attr_metadata_t* const meta) {
+    {
+        std::shared_lock<std::shared_mutex> lk(m_metadata_mtx);
+        auto it = m_metadata.find(meta);
+        if ( it != m_metadata.end() ) {
+            return it->second;
+        }
+    }
+    auto res = std::make_shared<taish::ListAttributeMetadataResponse>();
+    convert_metadata(meta, res->mutable_metadata());
+    std::unique_lock<std::shared_mutex> lk(m_metadata_mtx);
+    return m_metadata.emplace(meta, res).first->second;
+}
+
+void TAIServiceImpl::prepare_metadata(tai_object_id_t oid) {
+    uint32_t count;
+    tai_attr_metadata_t const * const *list;
+
+    if ( oid != TAI_NULL_OBJECT_ID ) {
+        tai_metadata_key_t key{.oid = oid};
+        if ( m_api->meta_api == nullptr || m_api->meta_api->list_metadata(&key, &count, &list) < 0 ) {
+            return;
+        }
+        for ( uint32_t i = 0; i < count; i++ ) {
+            metadata_response(list[i]);
+        }
+        return;
+    }
+
+    for ( auto type : {TAI_OBJECT_TYPE_MODULE, TAI_OBJECT_TYPE_NETWORKIF, TAI_OBJECT_TYPE_HOSTIF} ) {
+        auto info = tai_metadata_all_object_type_infos[type];
+        if ( info == nullptr ) {
+            continue;
+        }
+        for ( uint32_t i = 0; i < info->attrmetadatalength; i++ ) {
+            metadata_response(info->attrmetadata[i]);
+        }
+    }
+}
+
 ::grpc::Status TAIServiceImpl::GetAttributeMetadata(::grpc::ServerContext* context, const taish::GetAttributeMetadataRequest* request, taish::GetAttributeMetadataResponse* response) {
+    record(context, __func__, *request);
+    auto timer = rpc_timer(__func__);
     auto object_type = request->object_type();
     int32_t attr_id = 0;
     auto oid = request->oid();
@@ -216,21 +445,9 @@ static tai_serialize_option_t convert_serialize_option(const taish::SerializeOpt
                 add_status(context, TAI_STATUS_NOT_SUPPORTED);
                 return Status::OK;
             }
-            ret = tai_deserialize_enum(attr_name.c_str(), info->enummetadata, &attr_id, &option);
+            ret = resolve_attr_name(info->enummetadata, attr_name, &attr_id, &option);
         } else {
-            switch (object_type) {
-            case taish::MODULE:
-                ret = tai_deserialize_module_attr(attr_name.c_str(), &attr_id, &option);
-                break;
-            case taish::NETIF:
-                ret = tai_deserialize_network_interface_attr(attr_name.c_str(), &attr_id, &option);
-                break;
-            case taish::HOSTIF:
-                ret = tai_deserialize_host_interface_attr(attr_name.c_str(), &attr_id, &option);
-                break;
-            default:
-                ret = TAI_STATUS_NOT_SUPPORTED;
-            }
+            ret = resolve_attr_name(static_cast<tai_object_type_t>(object_type), attr_name, &attr_id, &option);
         }
 
         if ( ret < 0 ) {
@@ -245,14 +462,19 @@ static tai_serialize_option_t convert_serialize_option(const taish::SerializeOpt
     if ( meta == nullptr ) {
         return Status(StatusCode::NOT_FOUND, "not found metadata");
     }
-    auto res = response->mutable_metadata();
-    convert_metadata(meta, res);
+    response->mutable_metadata()->CopyFrom(metadata_response(meta)->metadata());
     add_status(context, TAI_STATUS_SUCCESS);
     return Status::OK;
 }
 
 
 ::grpc::Status TAIServiceImpl::GetAttributeCapability(::grpc::ServerContext* context, const taish::GetAttributeCapabilityRequest* request, taish::GetAttributeCapabilityResponse* response) {
+    record(context, __func__, *request);
+    auto timer = rpc_timer(__func__);
+    auto admitted = admit(context, {request->oid()});
+    if ( !admitted.ok() ) {
+        return admitted;
+    }
     auto oid = request->oid();
     tai_attr_id_t attr_id = request->attr_id();
     auto type = tai_object_type_query(oid);
@@ -264,6 +486,7 @@ static tai_serialize_option_t convert_serialize_option(const taish::SerializeOpt
     }
 
     auto getter = [&](tai_attribute_capability_t* cap) -> tai_status_t {
+        auto timer = adapter_timer("capability", type, attr_id);
         switch (type) {
         case TAI_OBJECT_TYPE_MODULE:
             if ( m_api->module_api->get_module_capability == nullptr ) {
@@ -286,6 +509,10 @@ static tai_serialize_option_t convert_serialize_option(const taish::SerializeOpt
     };
 
     try {
+        auto lk = lock_object(oid, TAI_PRIORITY_METADATA, context);
+        if ( !lk.status.ok() ) {
+            return lk.status;
+        }
         auto cap = std::make_unique<tai::Capability>(meta, getter);
         auto option = convert_serialize_option(request->serialize_option());
         convert_capability(option, meta, cap->raw(), response->mutable_capability());
@@ -297,9 +524,16 @@ static tai_serialize_option_t convert_serialize_option(const taish::SerializeOpt
 }
 
 ::grpc::Status TAIServiceImpl::GetAttribute(::grpc::ServerContext* context, const taish::GetAttributeRequest* request, taish::GetAttributeResponse* response) {
+    record(context, __func__, *request);
+    auto timer = rpc_timer(__func__);
+    auto admitted = admit(context, {request->oid()});
+    if ( !admitted.ok() ) {
+        return admitted;
+    }
     auto oid = request->oid();
     auto type = tai_object_type_query(oid);
     auto option = convert_serialize_option(request->serialize_option());
+    auto typed = request->serialize_option().typed();
 
     for ( int i = 0; i < request->attributes_size(); i++ ) {
         auto a = request->attributes(i);
@@ -317,7 +551,7 @@ static tai_serialize_option_t convert_serialize_option(const taish::SerializeOpt
                 }
             }
 
-            std::unique_lock<std::mutex> lk(m_mtx);
+            auto timer = adapter_timer("get", type, id);
 
             switch (type) {
             case TAI_OBJECT_TYPE_MODULE:
@@ -332,10 +566,46 @@ static tai_serialize_option_t convert_serialize_option(const taish::SerializeOpt
         };
 
         try {
-            auto attr = std::make_unique<tai::Attribute>(meta, getter);
+            // a value hint makes the result specific to this request
+            auto cacheable = value.size() == 0;
+            auto attr = cacheable ? m_cache.get(oid, meta) : nullptr;
+            // concurrent requests of the same attribute share one adapter call.
+            // when the call which reads gives up waiting for the adapter, the others try on their own
+            while ( attr == nullptr ) {
+                Status shed;
+                attr = m_flights.run(oid, id, value, [&]() -> tai::S_Attribute {
+                    auto lk = lock_object(oid, TAI_PRIORITY_GET, context);
+                    if ( !lk.status.ok() ) {
+                        shed = lk.status;
+                        return nullptr;
+                    }
+                    auto generation = m_cache.generation();
+                    auto attr = std::make_shared<tai::Attribute>(meta, getter);
+                    if ( cacheable ) {
+                        m_cache.put(oid, meta, attr, generation);
+                    }
+                    return attr;
+                }, [&](const TAISingleFlight::result_t& result) -> bool {
+                    // the call which reads may wait for the adapter longer than this call can
+                    tai_flight_waiter_t waiter(result);
+                    shed = acquire(waiter, context);
+                    return shed.ok();
+                });
+                if ( !shed.ok() ) {
+                    return shed;
+                }
+            }
             auto a = response->add_attributes();
             a->set_attr_id(id);
-            a->set_value(attr->to_string(&option));
+            if ( typed ) {
+                auto ret = convert_attribute_value(meta, &attr->raw()->value, a->mutable_typed_value());
+                if ( ret != TAI_STATUS_SUCCESS ) {
+                    add_status(context, ret);
+                    return Status::OK;
+                }
+            } else {
+                a->set_value(attr->to_string(&option));
+            }
         } catch (tai::Exception& e) {
             add_status(context, e.err());
             return Status::OK;
@@ -346,78 +616,452 @@ static tai_serialize_option_t convert_serialize_option(const taish::SerializeOpt
     return Status::OK;
 }
 
-::grpc::Status TAIServiceImpl::SetAttribute(::grpc::ServerContext* context, const taish::SetAttributeRequest* request, taish::SetAttributeResponse* response) {
-    auto oid = request->oid();
+static void set_attribute_result(taish::AttributeResult* res, tai_status_t status) {
+    res->set_code(status);
+    res->set_message(_serialize_status(status));
+}
+
+tai_status_t TAIServiceImpl::read_object_attributes(tai_object_id_t oid, const std::vector<tai_attr_id_t>& ids, std::vector<tai::S_Attribute>* attrs, std::vector<tai_status_t>* rets) {
     auto type = tai_object_type_query(oid);
-    auto option = convert_serialize_option(request->serialize_option());
 
-    std::vector<tai_attribute_t> attrs;
-    std::vector<tai::S_Attribute> ptrs; // only used for memory management
+    std::function<tai_status_t(uint32_t, tai_attribute_t*)> bulk_getter;
+    std::function<tai_status_t(tai_attribute_t*)> getter;
 
-    for ( int i = 0; i < request->attributes_size(); i++ ) {
-        auto a = request->attributes(i);
-        auto id = a.attr_id();
-        auto v = a.value();
+    switch (type) {
+    case TAI_OBJECT_TYPE_MODULE:
+        if ( m_api->module_api->get_module_attributes != nullptr ) {
+            bulk_getter = std::bind(m_api->module_api->get_module_attributes, oid, std::placeholders::_1, std::placeholders::_2);
+        }
+        getter = std::bind(m_api->module_api->get_module_attribute, oid, std::placeholders::_1);
+        break;
+    case TAI_OBJECT_TYPE_NETWORKIF:
+        if ( m_api->netif_api->get_network_interface_attributes != nullptr ) {
+            bulk_getter = std::bind(m_api->netif_api->get_network_interface_attributes, oid, std::placeholders::_1, std::placeholders::_2);
+        }
+        getter = std::bind(m_api->netif_api->get_network_interface_attribute, oid, std::placeholders::_1);
+        break;
+    case TAI_OBJECT_TYPE_HOSTIF:
+        if ( m_api->hostif_api->get_host_interface_attributes != nullptr ) {
+            bulk_getter = std::bind(m_api->hostif_api->get_host_interface_attributes, oid, std::placeholders::_1, std::placeholders::_2);
+        }
+        getter = std::bind(m_api->hostif_api->get_host_interface_attribute, oid, std::placeholders::_1);
+        break;
+    default:
+        return TAI_STATUS_INVALID_OBJECT_ID;
+    }
+
+    attrs->assign(ids.size(), nullptr);
+    rets->assign(ids.size(), TAI_STATUS_SUCCESS);
+
+    std::vector<const tai_attr_metadata_t*> metas;
+    std::vector<tai_attribute_t> list;
+    std::vector<size_t> indexes; // indexes[i] is the index of ids which corresponds to list[i]
+    auto generation = m_cache.generation();
+
+    for ( size_t i = 0; i < ids.size(); i++ ) {
         tai_metadata_key_t key{.oid = oid};
-        auto meta = get_metadata(m_api->meta_api, &key, id);
+        auto meta = get_metadata(m_api->meta_api, &key, ids[i]);
+        if ( meta == nullptr ) {
+            (*rets)[i] = TAI_STATUS_INVALID_PARAMETER;
+            continue;
+        }
+        auto cached = m_cache.get(oid, meta);
+        if ( cached != nullptr ) {
+            (*attrs)[i] = cached;
+            continue;
+        }
+        tai_attribute_t attr{.id = meta->attrid};
+        tai_alloc_info_t alloc_info = { .reference = &attr };
+        auto ret = tai_metadata_alloc_attr_value(meta, &attr, &alloc_info);
+        if ( ret != TAI_STATUS_SUCCESS ) {
+            (*rets)[i] = ret;
+            continue;
+        }
+        metas.emplace_back(meta);
+        list.emplace_back(attr);
+        indexes.emplace_back(i);
+    }
+
+    if ( list.size() == 0 ) {
+        return TAI_STATUS_SUCCESS;
+    }
+
+    tai_status_t ret = TAI_STATUS_NOT_SUPPORTED;
+    if ( bulk_getter ) {
+        // same retry policy as tai::Attribute. the adapter updates the count of the lists
+        // which were too short, so grow them before retrying
+        for ( int i = 0; i < 3; i++ ) {
+            auto timer = adapter_timer("get_bulk", type);
+            ret = bulk_getter(list.size(), list.data());
+            if ( ret != TAI_STATUS_BUFFER_OVERFLOW ) {
+                break;
+            }
+            for ( size_t j = 0; j < list.size(); j++ ) {
+                tai_alloc_info_t alloc_info = { .reference = &list[j] };
+                if ( tai_metadata_alloc_attr_value(metas[j], &list[j], &alloc_info) != TAI_STATUS_SUCCESS ) {
+                    break;
+                }
+            }
+        }
+    }
+
+    for ( size_t j = 0; j < list.size(); j++ ) {
+        auto i = indexes[j];
         try {
-            auto attr = std::make_shared<tai::Attribute>(meta, v, &option);
-            ptrs.emplace_back(attr);
-            attrs.emplace_back(*attr->raw());
-        } catch ( tai::Exception& e ) {
-            add_status(context, e.err());
-            return Status::OK;
+            // when the bulk call failed, we can't tell which attributes are valid.
+            // get them one by one so that each attribute gets its own status
+            auto timed_getter = [&](tai_attribute_t* attr) -> tai_status_t {
+                auto timer = adapter_timer("get", type, attr->id);
+                return getter(attr);
+            };
+            auto attr = ret == TAI_STATUS_SUCCESS ? std::make_shared<tai::Attribute>(metas[j], list[j]) : std::make_shared<tai::Attribute>(metas[j], timed_getter);
+            m_cache.put(oid, metas[j], attr, generation);
+            (*attrs)[i] = attr;
+        } catch (tai::Exception& e) {
+            (*rets)[i] = e.err();
         }
+        tai_metadata_free_attr_value(metas[j], &list[j], nullptr);
     }
+    return TAI_STATUS_SUCCESS;
+}
 
-    auto ret = TAI_STATUS_SUCCESS;
-    try {
-        std::unique_lock<std::mutex> lk(m_mtx);
-        switch (type) {
-        case TAI_OBJECT_TYPE_MODULE:
-            ret = m_api->module_api->set_module_attributes(oid, attrs.size(), attrs.data());
-            break;
-        case TAI_OBJECT_TYPE_NETWORKIF:
-            ret = m_api->netif_api->set_network_interface_attributes(oid, attrs.size(), attrs.data());
-            break;
-        case TAI_OBJECT_TYPE_HOSTIF:
-            ret = m_api->hostif_api->set_host_interface_attributes(oid, attrs.size(), attrs.data());
-            break;
-        default:
-            ret = TAI_STATUS_NOT_SUPPORTED;
+void TAIServiceImpl::get_object_attributes(const taish::ObjectAttributeIds& request, tai_serialize_option_t* option, bool typed, taish::ObjectAttributeResults* response) {
+    auto oid = request.oid();
+    response->set_oid(oid);
+
+    std::vector<tai_attr_id_t> ids(request.attr_ids().begin(), request.attr_ids().end());
+    std::vector<tai::S_Attribute> attrs;
+    std::vector<tai_status_t> rets;
+    auto ret = read_object_attributes(oid, ids, &attrs, &rets);
+    if ( ret != TAI_STATUS_SUCCESS ) {
+        response->set_code(ret);
+        response->set_message(_serialize_status(ret));
+        return;
+    }
+
+    for ( size_t i = 0; i < ids.size(); i++ ) {
+        auto res = response->add_attributes();
+        res->set_attr_id(ids[i]);
+        if ( attrs[i] == nullptr ) {
+            set_attribute_result(res, rets[i]);
+            continue;
         }
-    } catch (tai::Exception& e) {
-        ret = e.err();
+        ret = TAI_STATUS_SUCCESS;
+        if ( typed ) {
+            ret = convert_attribute_value(attrs[i]->metadata(), &attrs[i]->raw()->value, res->mutable_typed_value());
+        } else {
+            res->set_value(attrs[i]->to_string(option));
+        }
+        set_attribute_result(res, ret);
+    }
+}
+
+void TAIServiceImpl::read_attributes(const std::map<tai_object_id_t, std::vector<tai_attr_id_t>>& objects, std::map<tai_object_id_t, std::vector<tai::S_Attribute>>* values) {
+    std::map<tai_object_id_t, std::vector<tai_object_id_t>> modules;
+    for ( auto& o : objects ) {
+        modules[tai_module_id_query(o.first)].emplace_back(o.first);
+    }
+
+    for ( auto& m : modules ) {
+        auto lk = lock_object(m.second.front(), TAI_PRIORITY_GET);
+        for ( auto oid : m.second ) {
+            auto& ids = objects.at(oid);
+            std::vector<tai_status_t> rets;
+            auto& attrs = (*values)[oid];
+            if ( read_object_attributes(oid, ids, &attrs, &rets) != TAI_STATUS_SUCCESS ) {
+                attrs.assign(ids.size(), nullptr);
+            }
+        }
+    }
+}
+
+::grpc::Status TAIServiceImpl::BulkGetAttribute(::grpc::ServerContext* context, const taish::BulkGetAttributeRequest* request, taish::BulkGetAttributeResponse* response) {
+    record(context, __func__, *request);
+    auto timer = rpc_timer(__func__);
+    std::vector<tai_object_id_t> oids;
+    for ( auto& o : request->objects() ) {
+        oids.emplace_back(o.oid());
+    }
+    auto admitted = admit(context, oids);
+    if ( !admitted.ok() ) {
+        return admitted;
+    }
+    auto option = convert_serialize_option(request->serialize_option());
+
+    // group the objects per module so that the adapter lock is taken once per module
+    std::map<tai_object_id_t, std::vector<int>> modules;
+    for ( int i = 0; i < request->objects_size(); i++ ) {
+        modules[tai_module_id_query(request->objects(i).oid())].emplace_back(i);
+        response->add_objects();
+    }
+
+    for ( auto& m : modules ) {
+        auto lk = lock_object(request->objects(m.second.front()).oid(), TAI_PRIORITY_GET, context);
+        if ( !lk.status.ok() ) {
+            return lk.status;
+        }
+        for ( auto i : m.second ) {
+            get_object_attributes(request->objects(i), &option, request->serialize_option().typed(), response->mutable_objects(i));
+        }
+    }
+
+    add_status(context, TAI_STATUS_SUCCESS);
+    return Status::OK;
+}
+
+::grpc::Status TAIServiceImpl::GetStats(::grpc::ServerContext* context, const taish::GetStatsRequest* request, taish::GetStatsResponse* response) {
+    record(context, __func__, *request);
+    auto timer = rpc_timer(__func__);
+    collect_stats(response);
+    add_status(context, TAI_STATUS_SUCCESS);
+    return Status::OK;
+}
+
+void TAIServiceImpl::collect_stats(taish::GetStatsResponse* response) {
+    auto counters = response->mutable_counters();
+    auto cache = m_cache.stats();
+    (*counters)["cache.hits"] = cache.hits;
+    (*counters)["cache.misses"] = cache.misses;
+    (*counters)["cache.stale"] = cache.stale;
+    (*counters)["cache.invalidations"] = cache.invalidations;
+    (*counters)["cache.entries"] = cache.entries;
+    (*counters)["monitor.dropped"] = m_monitor_stats.dropped;
+    (*counters)["monitor.coalesced"] = m_monitor_stats.coalesced;
+    (*counters)["monitor.filtered"] = m_monitor_stats.filtered;
+    (*counters)["monitor.unconverted"] = m_monitor_stats.unconverted;
+    if ( m_topology != nullptr ) {
+        (*counters)["topology.version"] = m_topology->snapshot()->version;
+    }
+    (*counters)["singleflight.coalesced"] = m_flights.coalesced();
+    (*counters)["shed.expired"] = m_shed_expired;
+    (*counters)["shed.cancelled"] = m_shed_cancelled;
+    auto& admission = m_admission.stats();
+    (*counters)["admission.rejected_peer"] = admission.rejected_peer;
+    (*counters)["admission.rejected_module"] = admission.rejected_module;
+    if ( m_recorder != nullptr ) {
+        (*counters)["record.calls"] = m_recorder->recorded();
+    }
+    m_metrics.snapshot(response);
+}
+
+::grpc::Status TAIServiceImpl::SetAttribute(::grpc::ServerContext* context, const taish::SetAttributeRequest* request, taish::SetAttributeResponse* response) {
+    record(context, __func__, *request);
+    auto timer = rpc_timer(__func__);
+    auto admitted = admit(context, {request->oid()});
+    if ( !admitted.ok() ) {
+        return admitted;
+    }
+    auto oid = request->oid();
+    auto option = convert_serialize_option(request->serialize_option());
+    std::vector<tai::S_Attribute> attrs;
+    tai_metadata_key_t key{.oid = oid};
+    auto ret = resolve_attributes(&key, request->attributes(), &option, &attrs);
+    if ( ret == TAI_STATUS_SUCCESS ) {
+        auto lk = lock_object(oid, TAI_PRIORITY_CONTROL, context);
+        if ( !lk.status.ok() ) {
+            return lk.status;
+        }
+        ret = set_object_attributes(oid, attrs);
     }
     add_status(context, ret);
     return Status::OK;
 }
 
+tai_status_t TAIServiceImpl::set_attributes(tai_object_id_t oid, const std::vector<tai::S_Attribute>& attrs) {
+    auto lk = lock_object(oid, TAI_PRIORITY_CONTROL);
+    return set_object_attributes(oid, attrs);
+}
+
+tai_status_t TAIServiceImpl::create(tai_object_type_t type, tai_object_id_t mid, const std::vector<tai_attribute_t>& attrs, tai_object_id_t* oid) {
+    auto lk = lock_all();
+    auto timer = adapter_timer("create", type);
+    switch (type) {
+    case TAI_OBJECT_TYPE_MODULE:
+        return m_api->module_api->create_module(oid, attrs.size(), attrs.data());
+    case TAI_OBJECT_TYPE_NETWORKIF:
+        return m_api->netif_api->create_network_interface(oid, mid, attrs.size(), attrs.data());
+    case TAI_OBJECT_TYPE_HOSTIF:
+        return m_api->hostif_api->create_host_interface(oid, mid, attrs.size(), attrs.data());
+    default:
+        return TAI_STATUS_INVALID_OBJECT_TYPE;
+    }
+}
+
+tai_status_t TAIServiceImpl::get_module_attributes(tai_object_id_t oid, std::vector<tai_attribute_t>& attrs) {
+    auto lk = lock_object(oid, TAI_PRIORITY_GET);
+    auto timer = adapter_timer("get_bulk", TAI_OBJECT_TYPE_MODULE);
+    return m_api->module_api->get_module_attributes(oid, attrs.size(), attrs.data());
+}
+
 ::grpc::Status TAIServiceImpl::ClearAttribute(::grpc::ServerContext* context, const taish::ClearAttributeRequest* request, taish::ClearAttributeResponse* response) {
+    record(context, __func__, *request);
+    auto timer = rpc_timer(__func__);
+    auto admitted = admit(context, {request->oid()});
+    if ( !admitted.ok() ) {
+        return admitted;
+    }
     auto oid = request->oid();
     auto id = request->attr_id();
     auto type = tai_object_type_query(oid);
     tai_status_t ret;
-    std::unique_lock<std::mutex> lk(m_mtx);
+    auto lk = lock_object(oid, TAI_PRIORITY_CONTROL, context);
+    if ( !lk.status.ok() ) {
+        return lk.status;
+    }
 
     switch (type) {
     case TAI_OBJECT_TYPE_HOSTIF:
-        ret = m_api->hostif_api->clear_host_interface_attribute(oid, id);
+        {
+            auto timer = adapter_timer("clear", type, id);
+            ret = m_api->hostif_api->clear_host_interface_attribute(oid, id);
+        }
         break;
     default:
         ret = TAI_STATUS_FAILURE;
     }
+    m_cache.invalidate(oid);
+    m_flights.forget(oid);
     add_status(context, ret);
     return Status::OK;
 }
 
+void tai_subscription_t::push(const tai_notification_t& n) {
+    if ( max_size == 0 || q.size() < max_size ) {
+        q.push_back(n);
+        return;
+    }
+    if ( policy == TAI_OVERFLOW_POLICY_COALESCE ) {
+        for ( auto it = q.rbegin(); it != q.rend(); it++ ) {
+            if ( it->oid != n.oid ) {
+                continue;
+            }
+            it->rendered = nullptr;
+            for ( auto& a : n.attrs ) {
+                auto found = false;
+                for ( auto& b : it->attrs ) {
+                    if ( b->id() == a->id() ) {
+                        b = a;
+                        found = true;
+                        break;
+                    }
+                }
+                if ( !found ) {
+                    it->attrs.emplace_back(a);
+                }
+            }
+            if ( stats != nullptr ) {
+                stats->coalesced++;
+            }
+            return;
+        }
+    }
+    // nothing to coalesce with falls back to drop-oldest
+    q.pop_front();
+    q.push_back(n);
+    if ( stats != nullptr ) {
+        stats->dropped++;
+    }
+}
+
+// returns false when the value type of meta has no deadband
+static bool numeric_value(const tai_attr_metadata_t* meta, const tai_attribute_value_t& value, double* v) {
+    if ( meta->isenum ) {
+        return false;
+    }
+    switch (meta->attrvaluetype) {
+    case TAI_ATTR_VALUE_TYPE_U8:  *v = value.u8; return true;
+    case TAI_ATTR_VALUE_TYPE_S8:  *v = value.s8; return true;
+    case TAI_ATTR_VALUE_TYPE_U16: *v = value.u16; return true;
+    case TAI_ATTR_VALUE_TYPE_S16: *v = value.s16; return true;
+    case TAI_ATTR_VALUE_TYPE_U32: *v = value.u32; return true;
+    case TAI_ATTR_VALUE_TYPE_S32: *v = value.s32; return true;
+    case TAI_ATTR_VALUE_TYPE_U64: *v = value.u64; return true;
+    case TAI_ATTR_VALUE_TYPE_S64: *v = value.s64; return true;
+    case TAI_ATTR_VALUE_TYPE_FLT: *v = value.flt; return true;
+    default:
+        return false;
+    }
+}
+
+bool tai_subscription_t::filter(tai_notification_t* n) {
+    // an empty notification signals the removal of the object
+    if ( filters.empty() || n->attrs.empty() ) {
+        return true;
+    }
+    auto size = n->attrs.size();
+    auto it = n->attrs.begin();
+    while ( it != n->attrs.end() ) {
+        auto& a = *it;
+        auto f = filters.find(a->id());
+        auto pass = f != filters.end();
+        double v;
+        if ( pass && ( f->second.absolute > 0 || f->second.relative > 0 ) && numeric_value(a->metadata(), a->raw()->value, &v) ) {
+            auto key = std::make_pair(n->oid, a->id());
+            auto l = last.find(key);
+            if ( l != last.end() ) {
+                auto diff = std::abs(v - l->second);
+                pass = ( f->second.absolute > 0 && diff > f->second.absolute ) || ( f->second.relative > 0 && diff > f->second.relative * std::abs(l->second) );
+            }
+            if ( pass ) {
+                last[key] = v;
+            }
+        }
+        it = pass ? it + 1 : n->attrs.erase(it);
+    }
+    if ( stats != nullptr && n->attrs.size() < size ) {
+        stats->filtered += size - n->attrs.size();
+    }
+    return n->attrs.size() > 0;
+}
+
+// a value which can't be typed is rendered as a string instead, and counted in stats
+static std::shared_ptr<const taish::MonitorResponse> render_notification(const tai_notification_t& n, tai_serialize_option_t option, bool typed, tai_monitor_stats_t* stats) {
+    auto res = std::make_shared<taish::MonitorResponse>();
+    res->set_oid(n.oid);
+    for ( auto e : n.attrs ) {
+        auto a = res->add_attrs();
+        a->set_attr_id(e->id());
+        if ( typed ) {
+            if ( convert_attribute_value(e->metadata(), &e->raw()->value, a->mutable_typed_value()) == TAI_STATUS_SUCCESS ) {
+                continue;
+            }
+            a->clear_typed_value();
+            if ( stats != nullptr ) {
+                stats->unconverted++;
+            }
+        }
+        a->set_value(e->to_string(&option));
+    }
+    return res;
+}
+
 int TAINotifier::notify(const tai_notification_t& n) {
     std::unique_lock<std::mutex> lk(mtx);
+    // subscribers which use the same serialize option share the rendered response
+    std::map<int, std::shared_ptr<const taish::MonitorResponse>> rendered;
     for ( auto& s : m ) {
         auto v = s.second;
-        std::unique_lock<std::mutex> lk(v->mtx);
-        v->q.push(n);
-        v->cv.notify_one();
+        auto c = n;
+        if ( !v->filter(&c) ) {
+            continue;
+        }
+        // a notification which lost attributes to the filters is rendered by the stream
+        if ( c.attrs.size() == n.attrs.size() ) {
+            auto key = v->option.human | v->option.valueonly << 1 | v->option.json << 2 | v->typed << 3;
+            auto it = rendered.find(key);
+            if ( it == rendered.end() ) {
+                it = rendered.emplace(key, render_notification(n, v->option, v->typed, v->stats)).first;
+            }
+            c.rendered = it->second;
+        }
+        {
+            std::unique_lock<std::mutex> lk(v->mtx);
+            v->push(c);
+            v->cv.notify_one();
+        }
+        if ( v->wakeup ) {
+            v->wakeup();
+        }
     }
     return 0;
 }
@@ -437,23 +1081,63 @@ void monitor_callback(void* context, tai_object_id_t oid, uint32_t attr_count, t
             continue;
         }
         notification.attrs.emplace_back(std::make_shared<tai::Attribute>(meta, &attr_list[i]));
+        if ( n->cache() != nullptr ) {
+            n->cache()->invalidate(oid, attr_list[i].id);
+        }
     }
 
     n->notify(notification);
 }
 
-::grpc::Status TAIServiceImpl::Monitor(::grpc::ServerContext* context, const taish::MonitorRequest* request, ::grpc::ServerWriter< taish::MonitorResponse>* writer) {
-    auto oid = request->oid();
-    auto nid = request->notification_attr_id();
-    auto type = tai_object_type_query(oid);
-    tai_attribute_t attr = {0};
-    tai_status_t ret;
-    tai_subscription_t s;
-    std::shared_ptr<TAINotifier> notifier = nullptr;
-    auto key = std::pair<tai_object_id_t, tai_attr_id_t>(oid, nid);
-    auto option = convert_serialize_option(request->serialize_option());
-
-    tai_metadata_key_t k{.oid = oid};
+static tai_status_t set_notify_attribute(const tai_api_method_table_t* const api, tai_object_type_t type, tai_object_id_t oid, const tai_attribute_t* attr) {
+    switch (type) {
+    case TAI_OBJECT_TYPE_NETWORKIF:
+        return api->netif_api->set_network_interface_attribute(oid, attr);
+    case TAI_OBJECT_TYPE_HOSTIF:
+        return api->hostif_api->set_host_interface_attribute(oid, attr);
+    case TAI_OBJECT_TYPE_MODULE:
+        return api->module_api->set_module_attribute(oid, attr);
+    default:
+        return TAI_STATUS_NOT_SUPPORTED;
+    }
+}
+
+static void setup_subscription(tai_subscription_t* s, const taish::SerializeOption& option, uint32_t max_queue_size, taish::MonitorOverflowPolicy policy) {
+    s->option = convert_serialize_option(option);
+    s->typed = option.typed();
+    if ( max_queue_size > 0 ) {
+        s->max_size = max_queue_size;
+    }
+    switch (policy) {
+    case taish::MONITOR_COALESCE:
+        s->policy = TAI_OVERFLOW_POLICY_COALESCE;
+        break;
+    default:
+        s->policy = TAI_OVERFLOW_POLICY_DROP_OLDEST;
+    }
+}
+
+::grpc::Status TAIServiceImpl::start_monitor(::grpc::ServerContext* context, const taish::MonitorRequest* request, tai_monitor_t* m) {
+    record(context, "Monitor", *request);
+    auto admitted = admit(context, {request->oid()});
+    if ( !admitted.ok() ) {
+        return admitted;
+    }
+    m->oid = request->oid();
+    m->nid = request->notification_attr_id();
+    m->type = tai_object_type_query(m->oid);
+    m->attr = {0};
+    m->notifier = nullptr;
+    setup_subscription(&m->subscription, request->serialize_option(), request->max_queue_size(), request->overflow_policy());
+    m->subscription.stats = &m_monitor_stats;
+
+    auto oid = m->oid;
+    auto nid = m->nid;
+    auto type = m->type;
+    auto& attr = m->attr;
+    tai_status_t ret;
+
+    tai_metadata_key_t k{.oid = oid};
     auto meta = get_metadata(m_api->meta_api, &k, nid);
     if ( meta == nullptr ) {
         return Status(StatusCode::NOT_FOUND, "not found metadata");
@@ -463,282 +1147,669 @@ void monitor_callback(void* context, tai_object_id_t oid, uint32_t attr_count, t
         return Status(StatusCode::INVALID_ARGUMENT, "value type is not notification");
     }
 
+    for ( auto& f : request->filters() ) {
+        auto fmeta = get_metadata(m_api->meta_api, &k, f.attr_id());
+        if ( fmeta == nullptr ) {
+            return Status(StatusCode::NOT_FOUND, "not found metadata of the filter attribute");
+        }
+        if ( f.absolute_deadband() < 0 || f.relative_deadband() < 0 ) {
+            return Status(StatusCode::INVALID_ARGUMENT, "deadband must not be negative");
+        }
+        double v;
+        if ( ( f.absolute_deadband() > 0 || f.relative_deadband() > 0 ) && !numeric_value(fmeta, tai_attribute_value_t{}, &v) ) {
+            return Status(StatusCode::INVALID_ARGUMENT, "deadband is only for integer and float attributes");
+        }
+        m->subscription.filters[f.attr_id()] = tai_monitor_filter_t{f.absolute_deadband(), f.relative_deadband()};
+    }
 
-    {
-        std::unique_lock<std::mutex> lk(m_mtx);
+    // lock order: m_notifiers_mtx -> adapter locks (same as stop_monitor)
+    std::unique_lock<std::mutex> nlk(m_notifiers_mtx);
+    auto lk = lock_object(oid, TAI_PRIORITY_CONTROL);
 
-        attr.id = nid;
+    attr.id = nid;
 
-        switch (type) {
-        case TAI_OBJECT_TYPE_NETWORKIF:
-            ret = m_api->netif_api->get_network_interface_attribute(oid, &attr);
-            break;
-        case TAI_OBJECT_TYPE_HOSTIF:
-            ret = m_api->hostif_api->get_host_interface_attribute(oid, &attr);
-            break;
-        case TAI_OBJECT_TYPE_MODULE:
-            ret = m_api->module_api->get_module_attribute(oid, &attr);
-            break;
-        default:
-            ret = TAI_STATUS_NOT_SUPPORTED;
-        }
+    switch (type) {
+    case TAI_OBJECT_TYPE_NETWORKIF:
+        ret = m_api->netif_api->get_network_interface_attribute(oid, &attr);
+        break;
+    case TAI_OBJECT_TYPE_HOSTIF:
+        ret = m_api->hostif_api->get_host_interface_attribute(oid, &attr);
+        break;
+    case TAI_OBJECT_TYPE_MODULE:
+        ret = m_api->module_api->get_module_attribute(oid, &attr);
+        break;
+    default:
+        ret = TAI_STATUS_NOT_SUPPORTED;
+    }
+
+    if ( ret != TAI_STATUS_SUCCESS ) {
+        add_status(context, ret);
+        return Status::OK;
+    }
 
+    auto notifier = get_notifier(oid, nid);
+
+    if ( attr.value.notification.notify == nullptr ) {
+        attr.value.notification.notify = monitor_callback;
+        attr.value.notification.context = notifier.get();
+        ret = set_notify_attribute(m_api, type, oid, &attr);
         if ( ret != TAI_STATUS_SUCCESS ) {
             add_status(context, ret);
             return Status::OK;
         }
+    } else if ( attr.value.notification.notify != nullptr && notifier->size() == 0 ) {
+        return Status(StatusCode::UNKNOWN, "notify attribute is set by others");
+    }
 
-        notifier = get_notifier(oid, nid);
+    if ( notifier->subscribe(m, &m->subscription) < 0 ) {
+        return Status(StatusCode::UNKNOWN, "failed to subscribe");
+    }
+    m->notifier = notifier;
+    return Status::OK;
+}
 
-        if ( attr.value.notification.notify == nullptr ) {
-            attr.value.notification.notify = monitor_callback;
-            attr.value.notification.context = notifier.get();
-            switch (type) {
-            case TAI_OBJECT_TYPE_NETWORKIF:
-                ret = m_api->netif_api->set_network_interface_attribute(oid, &attr);
-                break;
-            case TAI_OBJECT_TYPE_HOSTIF:
-                ret = m_api->hostif_api->set_host_interface_attribute(oid, &attr);
-                break;
-            case TAI_OBJECT_TYPE_MODULE:
-                ret = m_api->module_api->set_module_attribute(oid, &attr);
-                break;
-            default:
-                ret = TAI_STATUS_NOT_SUPPORTED;
-            }
-            if ( ret != TAI_STATUS_SUCCESS ) {
-                add_status(context, ret);
-                return Status::OK;
-            }
-        } else if ( attr.value.notification.notify != nullptr && notifier->size() == 0 ) {
-            return Status(StatusCode::UNKNOWN, "notify attribute is set by others");
-        }
+::grpc::Status TAIServiceImpl::stop_monitor(::grpc::ServerContext* context, tai_monitor_t* m) {
+    auto notifier = m->notifier;
+    if ( notifier == nullptr ) {
+        return Status::OK;
+    }
+    auto key = std::pair<tai_object_id_t, tai_attr_id_t>(m->oid, m->nid);
+
+    std::unique_lock<std::mutex> lk(m_notifiers_mtx);
 
-        if ( notifier->subscribe(writer, &s) < 0 ) {
-            return Status(StatusCode::UNKNOWN, "failed to subscribe");
+    if ( notifier->size() == 1 ) {
+        auto lk = lock_object(m->oid, TAI_PRIORITY_CONTROL);
+        m->attr.value.notification.notify = nullptr;
+        m->attr.value.notification.context = nullptr;
+        auto ret = set_notify_attribute(m_api, m->type, m->oid, &m->attr);
+        if ( ret != TAI_STATUS_SUCCESS ) {
+            add_status(context, ret);
+            return Status::OK;
         }
     }
 
+    if ( notifier->desubscribe(m) < 0 ) {
+        return Status(StatusCode::UNKNOWN, "failed to desubscribe");
+    }
+
+    if ( notifier->size() == 0 ) {
+        m_notifiers.erase(key);
+    }
+    return Status::OK;
+}
+
+bool TAIServiceImpl::is_monitoring(const tai_monitor_t* m) {
+    auto key = std::pair<tai_object_id_t, tai_attr_id_t>(m->oid, m->nid);
+    std::unique_lock<std::mutex> lk(m_notifiers_mtx);
+    return m_notifiers.find(key) != m_notifiers.end();
+}
+
+size_t TAIServiceImpl::pop_notifications(tai_subscription_t* s, std::vector<std::shared_ptr<const taish::MonitorResponse>>* res) {
+    std::deque<tai_notification_t> q;
     {
+        std::unique_lock<std::mutex> lk(s->mtx);
+        q.swap(s->q);
+    }
 
-        std::unique_lock<std::mutex> lk(s.mtx);
+    if ( q.size() > 0 ) {
+        m_metrics.histogram("monitor_queue_depth", "")->observe(q.size());
+    }
+
+    for ( auto& n : q ) {
+        if ( n.rendered == nullptr ) {
+            n.rendered = render_notification(n, s->option, s->typed, s->stats);
+        }
+        res->emplace_back(n.rendered);
+    }
+    return q.size();
+}
 
-        while(true) {
+// writes the notifications queued in s until the client is gone.
+// returns false when alive returned false
+template<typename S, typename Res>
+static bool stream_notifications(TAIServiceImpl* handler, ::grpc::ServerContext* context, S* s, ::grpc::ServerWriter<Res>* writer, std::function<bool()> alive) {
+    std::vector<std::shared_ptr<const Res>> res;
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lk(s->mtx);
+            // the sync API has no done notification. the timeout only bounds how long
+            // a cancelled stream stays subscribed when no notification arrives
             std::chrono::seconds sec(1);
-            s.cv.wait_for(lk, sec, [&]{ return !s.q.empty(); });
+            s->cv.wait_for(lk, sec, [&]{ return !s->q.empty(); });
+        }
 
-            if ( context->IsCancelled() ) {
-                break;
-            }
+        if ( context->IsCancelled() ) {
+            return true;
+        }
 
-            {
-                std::unique_lock<std::mutex> lk(m_notifiers_mtx);
-                if ( m_notifiers.find(key) == m_notifiers.end() ) {
-                    return Status(StatusCode::UNKNOWN, "object is removed");
-                }
-            }
+        if ( !alive() ) {
+            return false;
+        }
 
-            if ( s.q.size() == 0 ) {
-                continue;
+        res.clear();
+        handler->pop_notifications(s, &res);
+
+        for ( auto& r : res ) {
+            if ( !writer->Write(*r) ) {
+                return true;
             }
+        }
+    }
+}
 
-            auto n = s.q.front();
-            s.q.pop();
+::grpc::Status TAIServiceImpl::Monitor(::grpc::ServerContext* context, const taish::MonitorRequest* request, ::grpc::ServerWriter< taish::MonitorResponse>* writer) {
+    tai_monitor_t m;
 
-            taish::MonitorResponse res;
-            for ( auto e : n.attrs ) {
-                auto a = res.add_attrs();
-                a->set_attr_id(e->id());
-                a->set_value(e->to_string(&option));
-            }
+    auto status = start_monitor(context, request, &m);
+    if ( !m.subscribed() ) {
+        return status;
+    }
 
-            if (!writer->Write(res)) {
-                break;
-            }
+    if ( !stream_notifications(this, context, &m.subscription, writer, [&]() { return is_monitoring(&m); }) ) {
+        return Status(StatusCode::UNKNOWN, "object is removed");
+    }
+
+    return stop_monitor(context, &m);
+}
+
+::grpc::Status TAIServiceImpl::start_subscribe(::grpc::ServerContext* context, const taish::SubscribeRequest* request, tai_telemetry_t* t) {
+    record(context, "Subscribe", *request);
+    if ( request->paths_size() == 0 ) {
+        return Status(StatusCode::INVALID_ARGUMENT, "no path to subscribe");
+    }
+    std::vector<tai_object_id_t> oids;
+    for ( auto& p : request->paths() ) {
+        oids.emplace_back(p.oid());
+    }
+    auto admitted = admit(context, oids);
+    if ( !admitted.ok() ) {
+        return admitted;
+    }
+
+    auto tick = m_sampler.tick_interval().count();
+    for ( auto& p : request->paths() ) {
+        tai_metadata_key_t key{.oid = p.oid()};
+        auto meta = get_metadata(m_api->meta_api, &key, p.attr_id());
+        if ( meta == nullptr ) {
+            return Status(StatusCode::NOT_FOUND, "not found metadata");
         }
+        if ( meta->attrvaluetype == TAI_ATTR_VALUE_TYPE_NOTIFICATION ) {
+            return Status(StatusCode::INVALID_ARGUMENT, "notification attribute can't be sampled. use Monitor");
+        }
+        uint64_t interval = p.sample_interval_ms() > 0 ? p.sample_interval_ms() : 1000;
+        interval = (interval + tick - 1) / tick;
+        t->paths.emplace_back(tai_telemetry_path_t{
+            .oid = p.oid(),
+            .module = tai_module_id_query(p.oid()),
+            .id = meta->attrid,
+            .interval = interval > 0 ? interval : 1,
+            .on_change = p.mode() == taish::SUBSCRIBE_ON_CHANGE,
+        });
+    }
 
+    setup_subscription(&t->subscription, request->serialize_option(), request->max_queue_size(), request->overflow_policy());
+    t->subscription.stats = &m_monitor_stats;
+
+    m_sampler.add(t);
+    t->scheduled = true;
+    return Status::OK;
+}
+
+::grpc::Status TAIServiceImpl::stop_subscribe(::grpc::ServerContext* context, tai_telemetry_t* t) {
+    if ( t->scheduled ) {
+        m_sampler.remove(t);
+        t->scheduled = false;
     }
+    return Status::OK;
+}
 
-    {
-        std::unique_lock<std::mutex> lk(m_notifiers_mtx);
+bool TAIServiceImpl::is_sampling(const tai_telemetry_t* t) {
+    return !t->removed;
+}
 
-        if ( notifier->size() == 1 ) {
-            std::unique_lock<std::mutex> lk(m_mtx);
-            attr.value.notification.notify = nullptr;
-            attr.value.notification.context = nullptr;
-            switch (type) {
-            case TAI_OBJECT_TYPE_NETWORKIF:
-                ret = m_api->netif_api->set_network_interface_attribute(oid, &attr);
-                break;
-            case TAI_OBJECT_TYPE_HOSTIF:
-                ret = m_api->hostif_api->set_host_interface_attribute(oid, &attr);
-                break;
-            case TAI_OBJECT_TYPE_MODULE:
-                ret = m_api->module_api->set_module_attribute(oid, &attr);
-                break;
-            default:
-                ret = TAI_STATUS_NOT_SUPPORTED;
-            }
-            if ( ret != TAI_STATUS_SUCCESS ) {
-                add_status(context, ret);
-                return Status::OK;
-            }
-        }
+::grpc::Status TAIServiceImpl::Subscribe(::grpc::ServerContext* context, const taish::SubscribeRequest* request, ::grpc::ServerWriter< taish::MonitorResponse>* writer) {
+    tai_telemetry_t t;
 
-        if ( notifier->desubscribe(writer) < 0 ) {
-            return Status(StatusCode::UNKNOWN, "failed to desubscribe");
-        }
+    auto status = start_subscribe(context, request, &t);
+    if ( !t.subscribed() ) {
+        return status;
+    }
 
-        if ( notifier->size() == 0 ) {
-            m_notifiers.erase(key);
-        }
+    if ( !stream_notifications(this, context, &t.subscription, writer, [&]() { return is_sampling(&t); }) ) {
+        stop_subscribe(context, &t);
+        return Status(StatusCode::UNKNOWN, "object is removed");
+    }
 
+    return stop_subscribe(context, &t);
+}
+
+::grpc::Status TAIServiceImpl::start_watch_topology(::grpc::ServerContext* context, const taish::WatchTopologyRequest* request, tai_topology_watch_t* w) {
+    record(context, "WatchTopology", *request);
+    if ( m_topology == nullptr ) {
+        return Status(StatusCode::UNIMPLEMENTED, "topology is not published");
     }
+    m_topology->watch(&w->subscription);
+    w->watching = true;
+    return Status::OK;
+}
 
+::grpc::Status TAIServiceImpl::stop_watch_topology(::grpc::ServerContext* context, tai_topology_watch_t* w) {
+    m_topology->unwatch(&w->subscription);
+    w->watching = false;
     return Status::OK;
 }
 
+size_t TAIServiceImpl::pop_notifications(tai_topology_subscription_t* s, std::vector<std::shared_ptr<const taish::WatchTopologyResponse>>* res) {
+    std::unique_lock<std::mutex> lk(s->mtx);
+    auto n = s->q.size();
+    res->insert(res->end(), s->q.begin(), s->q.end());
+    s->q.clear();
+    return n;
+}
+
+::grpc::Status TAIServiceImpl::WatchTopology(::grpc::ServerContext* context, const taish::WatchTopologyRequest* request, ::grpc::ServerWriter< taish::WatchTopologyResponse>* writer) {
+    tai_topology_watch_t w;
+
+    auto status = start_watch_topology(context, request, &w);
+    if ( !w.subscribed() ) {
+        return status;
+    }
+
+    stream_notifications(this, context, &w.subscription, writer, []() { return true; });
+
+    return stop_watch_topology(context, &w);
+}
+
 ::grpc::Status TAIServiceImpl::SetLogLevel(::grpc::ServerContext* context, const taish::SetLogLevelRequest* request, taish::SetLogLevelResponse* response) {
+    record(context, __func__, *request);
+    auto timer = rpc_timer(__func__);
     auto ret = tai_log_set(static_cast<tai_api_t>(request->api()), static_cast<tai_log_level_t>(request->level()), nullptr);
     add_status(context, ret);
     return Status::OK;
 }
 
-::grpc::Status TAIServiceImpl::Create(::grpc::ServerContext* context, const taish::CreateRequest* request, taish::CreateResponse* response) {
-    auto object_type = request->object_type();
-    auto mid = static_cast<tai_object_id_t>(request->module_id());
-    tai_object_type_t type;
+tai_status_t TAIServiceImpl::resolve_attributes(const tai_metadata_key_t* const key, const google::protobuf::RepeatedPtrField<taish::Attribute>& src, tai_serialize_option_t* option, std::vector<tai::S_Attribute>* dst) {
+    auto type = key->type;
+    if ( key->oid != TAI_NULL_OBJECT_ID ) {
+        type = tai_object_type_query(key->oid);
+    }
+    const tai_enum_metadata_t* names = nullptr;
+
+    for ( auto& a : src ) {
+        int32_t id = a.attr_id();
+        if ( a.attr_name() != "" ) {
+            int ret;
+            if ( m_api->meta_api != nullptr && m_api->meta_api->get_object_info != nullptr ) {
+                if ( names == nullptr ) {
+                    auto info = m_api->meta_api->get_object_info(key);
+                    if ( info == nullptr ) {
+                        return TAI_STATUS_NOT_SUPPORTED;
+                    }
+                    names = info->enummetadata;
+                }
+                ret = resolve_attr_name(names, a.attr_name(), &id, option);
+            } else {
+                ret = resolve_attr_name(type, a.attr_name(), &id, option);
+            }
+            if ( ret < 0 ) {
+                return TAI_STATUS_INVALID_PARAMETER;
+            }
+        }
+        auto meta = get_metadata(m_api->meta_api, key, id);
+        try {
+            dst->emplace_back(a.has_typed_value() ? convert_attribute_value(meta, a.typed_value()) : std::make_shared<tai::Attribute>(meta, a.value(), option));
+        } catch ( tai::Exception& e ) {
+            return e.err();
+        }
+    }
+    return TAI_STATUS_SUCCESS;
+}
+
+tai_status_t TAIServiceImpl::create_object(tai_object_type_t type, tai_object_id_t mid, const google::protobuf::RepeatedPtrField<taish::Attribute>& src, tai_serialize_option_t* option, tai_object_id_t* oid, int* index) {
     std::function<tai_status_t(tai_object_id_t*, uint32_t, const tai_attribute_t*)> create;
 
-    switch (object_type) {
-    case taish::MODULE:
-        type = TAI_OBJECT_TYPE_MODULE;
+    switch (type) {
+    case TAI_OBJECT_TYPE_MODULE:
         create = m_api->module_api->create_module;
         break;
-    case taish::NETIF:
-        type = TAI_OBJECT_TYPE_NETWORKIF;
+    case TAI_OBJECT_TYPE_NETWORKIF:
         create = std::bind(m_api->netif_api->create_network_interface, std::placeholders::_1, mid, std::placeholders::_2, std::placeholders::_3);
         break;
-    case taish::HOSTIF:
-        type = TAI_OBJECT_TYPE_HOSTIF;
+    case TAI_OBJECT_TYPE_HOSTIF:
         create = std::bind(m_api->hostif_api->create_host_interface, std::placeholders::_1, mid, std::placeholders::_2, std::placeholders::_3);
         break;
     default:
-        return Status(StatusCode::INVALID_ARGUMENT, "unsupported object type");
+        return TAI_STATUS_INVALID_OBJECT_TYPE;
     }
 
-    std::vector<tai::S_Attribute> attrs;
-    auto option = convert_serialize_option(request->serialize_option());
-
+    // the metadata of the attributes may depend on the location of the module
     tai_metadata_key_t key{.type = TAI_OBJECT_TYPE_MODULE};
     auto meta = get_metadata(m_api->meta_api, &key, TAI_MODULE_ATTR_LOCATION);
     tai::S_Attribute loc;
     if ( type != TAI_OBJECT_TYPE_MODULE ) {
-        std::unique_lock<std::mutex> lk(m_mtx);
         auto getter = [&](tai_attribute_t* attr) -> tai_status_t {
             return m_api->module_api->get_module_attribute(mid, attr);
         };
         try {
-            loc = std::make_unique<tai::Attribute>(meta, getter);
+            loc = std::make_shared<tai::Attribute>(meta, getter);
         } catch ( tai::Exception& e ) {
-            add_status(context, e.err());
-            return Status::OK;
+            return e.err();
         }
     } else {
-        for ( auto i = 0; i < request->attrs_size(); i++ ) {
-            auto a = request->attrs(i);
-            auto id = a.attr_id();
+        for ( auto& a : src ) {
+            // the location is a standard attribute. no need to ask the adapter to resolve the name
+            int32_t id = a.attr_id();
+            if ( a.attr_name() != "" && resolve_attr_name(TAI_OBJECT_TYPE_MODULE, a.attr_name(), &id, option) < 0 ) {
+                continue;
+            }
             if ( id == TAI_MODULE_ATTR_LOCATION ) {
-                loc = std::make_unique<tai::Attribute>(meta, a.value());
+                try {
+                    loc = a.has_typed_value() ? convert_attribute_value(meta, a.typed_value()) : std::make_shared<tai::Attribute>(meta, a.value());
+                } catch ( tai::Exception& e ) {
+                    return e.err();
+                }
                 break;
             }
         }
         if ( !loc ) {
-            add_status(context, TAI_STATUS_MANDATORY_ATTRIBUTE_MISSING);
-            return Status::OK;
+            return TAI_STATUS_MANDATORY_ATTRIBUTE_MISSING;
         }
     }
 
-    int index = 0;
+    std::vector<tai::S_Attribute> attrs;
+    key = tai_metadata_key_t{.type = type, .location = loc->raw()->value.charlist};
+    auto ret = resolve_attributes(&key, src, option, &attrs);
+    if ( ret != TAI_STATUS_SUCCESS ) {
+        return ret;
+    }
 
-    try {
-        for ( auto i = 0; i < request->attrs_size(); i++ ) {
-            auto a = request->attrs(i);
-            auto id = a.attr_id();
-            auto v = a.value();
-            tai_metadata_key_t key{.type = type, .location = loc->raw()->value.charlist};
-            auto meta = get_metadata(m_api->meta_api, &key, id);
-            auto attr = std::make_shared<tai::Attribute>(meta, v, &option);
-            attrs.emplace_back(attr);
-
-            if (type == TAI_OBJECT_TYPE_HOSTIF && attr->id() == TAI_HOST_INTERFACE_ATTR_INDEX) {
-                index = attr->raw()->value.u32;
-            } else if (type == TAI_OBJECT_TYPE_NETWORKIF && attr->id() == TAI_NETWORK_INTERFACE_ATTR_INDEX) {
-                index = attr->raw()->value.u32;
-            }
+    std::vector<tai_attribute_t> list;
+    *index = 0;
+    for ( auto& attr : attrs ) {
+        list.emplace_back(*(attr->raw()));
+        if (type == TAI_OBJECT_TYPE_HOSTIF && attr->id() == TAI_HOST_INTERFACE_ATTR_INDEX) {
+            *index = attr->raw()->value.u32;
+        } else if (type == TAI_OBJECT_TYPE_NETWORKIF && attr->id() == TAI_NETWORK_INTERFACE_ATTR_INDEX) {
+            *index = attr->raw()->value.u32;
         }
-    } catch (tai::Exception& e) {
-        add_status(context, e.err());
-        return Status::OK;
     }
 
-    tai_object_id_t oid;
-    std::vector<tai_attribute_t> list;
-    for ( auto& v : attrs ) {
-        list.emplace_back(*(v->raw()));
+    auto timer = adapter_timer("create", type);
+    return create(oid, list.size(), list.data());
+}
+
+void TAIServiceImpl::object_created(tai_object_type_t type, tai_object_id_t oid, int index) {
+    prepare_metadata(oid);
+    m_api->object_update(type, oid, index, true);
+}
+
+tai_status_t TAIServiceImpl::set_object_attributes(tai_object_id_t oid, const std::vector<tai::S_Attribute>& src) {
+    auto type = tai_object_type_query(oid);
+    std::vector<tai_attribute_t> attrs;
+    for ( auto& attr : src ) {
+        attrs.emplace_back(*attr->raw());
+    }
+
+    tai_status_t ret;
+    auto timer = adapter_timer("set", type, attrs.size() == 1 ? attrs[0].id : 0);
+    switch (type) {
+    case TAI_OBJECT_TYPE_MODULE:
+        ret = m_api->module_api->set_module_attributes(oid, attrs.size(), attrs.data());
+        break;
+    case TAI_OBJECT_TYPE_NETWORKIF:
+        ret = m_api->netif_api->set_network_interface_attributes(oid, attrs.size(), attrs.data());
+        break;
+    case TAI_OBJECT_TYPE_HOSTIF:
+        ret = m_api->hostif_api->set_host_interface_attributes(oid, attrs.size(), attrs.data());
+        break;
+    default:
+        ret = TAI_STATUS_NOT_SUPPORTED;
+    }
+    // a set may change other attributes of the object too (e.g. admin-status -> oper-status)
+    m_cache.invalidate(oid);
+    m_flights.forget(oid);
+    return ret;
+}
+
+tai_status_t TAIServiceImpl::remove_object(tai_object_id_t oid) {
+    auto type = tai_object_type_query(oid);
+    tai_status_t ret;
+    auto timer = adapter_timer("remove", type);
+    switch (type) {
+    case TAI_OBJECT_TYPE_MODULE:
+        ret = m_api->module_api->remove_module(oid);
+        if ( ret == TAI_STATUS_SUCCESS ) {
+            std::unique_lock<std::mutex> mlk(m_module_mtxs_mtx);
+            m_module_mtxs.erase(oid);
+            m_admission.forget_module(oid);
+            // the interfaces of the module are gone as well
+            m_cache.clear();
+            std::unique_lock<std::shared_mutex> mdlk(m_metadata_mtx);
+            m_metadata.clear();
+        }
+        break;
+    case TAI_OBJECT_TYPE_NETWORKIF:
+        ret = m_api->netif_api->remove_network_interface(oid);
+        break;
+    case TAI_OBJECT_TYPE_HOSTIF:
+        ret = m_api->hostif_api->remove_host_interface(oid);
+        break;
+    default:
+        ret = TAI_STATUS_NOT_SUPPORTED;
+    }
+    if ( ret == TAI_STATUS_SUCCESS ) {
+        m_cache.invalidate(oid);
+        m_flights.forget(oid);
+    }
+    return ret;
+}
+
+void TAIServiceImpl::object_removed(tai_object_type_t type, tai_object_id_t oid) {
+    std::unique_lock<std::mutex> lk(m_notifiers_mtx);
+    auto it = m_notifiers.begin();
+    while  ( it != m_notifiers.end() ) {
+        if ( it->first.first == oid ) {
+            auto notifier = it->second;
+            tai_notification_t empty;
+            it = m_notifiers.erase(it);
+            notifier->notify(empty); // signal the deletion
+        } else {
+            it++;
+        }
     }
+    m_api->object_update(type, oid, 0, false);
+    lk.unlock();
+    // the streams of the sampler end as the monitors above do
+    m_sampler.object_removed(oid);
+}
 
+::grpc::Status TAIServiceImpl::Create(::grpc::ServerContext* context, const taish::CreateRequest* request, taish::CreateResponse* response) {
+    record(context, __func__, *request);
+    auto timer = rpc_timer(__func__);
+    auto admitted = admit(context, {request->module_id()});
+    if ( !admitted.ok() ) {
+        return admitted;
+    }
+    tai_object_type_t type;
+
+    switch (request->object_type()) {
+    case taish::MODULE:
+        type = TAI_OBJECT_TYPE_MODULE;
+        break;
+    case taish::NETIF:
+        type = TAI_OBJECT_TYPE_NETWORKIF;
+        break;
+    case taish::HOSTIF:
+        type = TAI_OBJECT_TYPE_HOSTIF;
+        break;
+    default:
+        return Status(StatusCode::INVALID_ARGUMENT, "unsupported object type");
+    }
+
+    auto option = convert_serialize_option(request->serialize_option());
+    tai_object_id_t oid;
+    int index;
     tai_status_t ret;
 
     {
-        std::unique_lock<std::mutex> lk(m_mtx);
-        ret = create(&oid, list.size(), list.data());
+        auto lk = lock_all(context);
+        if ( !lk.status.ok() ) {
+            return lk.status;
+        }
+        ret = create_object(type, request->module_id(), request->attrs(), &option, &oid, &index);
     }
 
     if ( ret == TAI_STATUS_SUCCESS ) {
         response->set_oid(oid);
-        m_api->object_update(type, oid, index, true);
+        object_created(type, oid, index);
     }
     add_status(context, ret);
     return Status::OK;
 }
 
 ::grpc::Status TAIServiceImpl::Remove(::grpc::ServerContext* context, const taish::RemoveRequest* request, taish::RemoveResponse* response) {
+    record(context, __func__, *request);
+    auto timer = rpc_timer(__func__);
+    auto admitted = admit(context, {request->oid()});
+    if ( !admitted.ok() ) {
+        return admitted;
+    }
     auto oid = request->oid();
     auto type = tai_object_type_query(oid);
     tai_status_t ret;
     {
-        std::unique_lock<std::mutex> lk(m_mtx);
-        switch (type) {
-        case TAI_OBJECT_TYPE_MODULE:
-            ret = m_api->module_api->remove_module(oid);
-            break;
-        case TAI_OBJECT_TYPE_NETWORKIF:
-            ret = m_api->netif_api->remove_network_interface(oid);
-            break;
-        case TAI_OBJECT_TYPE_HOSTIF:
-            ret = m_api->hostif_api->remove_host_interface(oid);
-            break;
-        default:
-            ret = TAI_STATUS_NOT_SUPPORTED;
+        auto lk = lock_all(context);
+        if ( !lk.status.ok() ) {
+            return lk.status;
         }
+        ret = remove_object(oid);
     }
 
     if ( ret == TAI_STATUS_SUCCESS ) {
-        std::unique_lock<std::mutex> lk(m_notifiers_mtx);
-        auto it = m_notifiers.begin();
-        while  ( it != m_notifiers.end() ) {
-            if ( it->first.first == oid ) {
-                auto notifier = it->second;
-                tai_notification_t empty;
-                it = m_notifiers.erase(it);
-                notifier->notify(empty); // signal the deletion
-            } else {
-                it++;
+        object_removed(type, oid);
+    }
+    add_status(context, ret);
+    return Status::OK;
+}
+
+static void set_provision_result(taish::ProvisionResult* res, tai_object_id_t oid, tai_status_t status) {
+    res->set_oid(oid);
+    res->set_code(status);
+    res->set_message(_serialize_status(status));
+}
+
+::grpc::Status TAIServiceImpl::Provision(::grpc::ServerContext* context, const taish::ProvisionRequest* request, taish::ProvisionResponse* response) {
+    record(context, __func__, *request);
+    auto timer = rpc_timer(__func__);
+    std::vector<tai_object_id_t> mids;
+    for ( auto& group : request->groups() ) {
+        mids.emplace_back(group.module_id());
+    }
+    auto admitted = admit(context, mids);
+    if ( !admitted.ok() ) {
+        return admitted;
+    }
+    auto option = convert_serialize_option(request->serialize_option());
+
+    for ( auto& group : request->groups() ) {
+        auto results = response->add_groups();
+        tai_object_id_t mid = group.module_id();
+        tai_object_id_t last = TAI_NULL_OBJECT_ID; // the object created last in the group
+
+        // the objects are created and removed after the loop, without holding the adapter lock
+        std::vector<std::tuple<tai_object_type_t, tai_object_id_t, int>> created;
+        std::vector<std::pair<tai_object_type_t, tai_object_id_t>> removed;
+
+        // creating or removing objects needs the exclusive lock. otherwise the module is enough
+        auto exclusive = mid == TAI_NULL_OBJECT_ID;
+        for ( auto& op : group.operations() ) {
+            if ( op.type() != taish::PROVISION_SET ) {
+                exclusive = true;
             }
         }
-        m_api->object_update(type, oid, 0, false);
+
+        {
+            auto lk = exclusive ? lock_all() : lock_object(mid, TAI_PRIORITY_CONTROL);
+            auto ret = TAI_STATUS_SUCCESS;
+
+            for ( auto& op : group.operations() ) {
+                auto res = results->add_operations();
+                if ( ret != TAI_STATUS_SUCCESS ) {
+                    set_provision_result(res, op.oid(), TAI_STATUS_NOT_EXECUTED);
+                    continue;
+                }
+
+                if ( op.type() == taish::PROVISION_CREATE ) {
+                    tai_object_type_t type;
+                    switch (op.object_type()) {
+                    case taish::MODULE:
+                        type = TAI_OBJECT_TYPE_MODULE;
+                        break;
+                    case taish::NETIF:
+                        type = TAI_OBJECT_TYPE_NETWORKIF;
+                        break;
+                    case taish::HOSTIF:
+                        type = TAI_OBJECT_TYPE_HOSTIF;
+                        break;
+                    default:
+                        type = TAI_OBJECT_TYPE_NULL;
+                    }
+                    tai_object_id_t oid = TAI_NULL_OBJECT_ID;
+                    int index;
+                    ret = create_object(type, mid, op.attrs(), &option, &oid, &index);
+                    if ( ret == TAI_STATUS_SUCCESS ) {
+                        created.emplace_back(type, oid, index);
+                        last = oid;
+                        if ( type == TAI_OBJECT_TYPE_MODULE ) {
+                            mid = oid;
+                        }
+                    }
+                    set_provision_result(res, oid, ret);
+                    continue;
+                }
+
+                auto oid = op.oid();
+                if ( oid == TAI_NULL_OBJECT_ID ) {
+                    oid = last != TAI_NULL_OBJECT_ID ? last : mid;
+                }
+
+                if ( !exclusive && tai_module_id_query(oid) != mid ) {
+                    // only the module of the group is locked
+                    ret = TAI_STATUS_INVALID_OBJECT_ID;
+                } else if ( op.type() == taish::PROVISION_SET ) {
+                    std::vector<tai::S_Attribute> attrs;
+                    tai_metadata_key_t key{.oid = oid};
+                    ret = resolve_attributes(&key, op.attrs(), &option, &attrs);
+                    if ( ret == TAI_STATUS_SUCCESS ) {
+                        ret = set_object_attributes(oid, attrs);
+                    }
+                } else if ( op.type() == taish::PROVISION_REMOVE ) {
+                    auto type = tai_object_type_query(oid);
+                    ret = remove_object(oid);
+                    if ( ret == TAI_STATUS_SUCCESS ) {
+                        removed.emplace_back(type, oid);
+                        if ( oid == last ) {
+                            last = TAI_NULL_OBJECT_ID;
+                        }
+                        if ( oid == mid ) {
+                            mid = TAI_NULL_OBJECT_ID;
+                        }
+                    }
+                } else {
+                    ret = TAI_STATUS_INVALID_PARAMETER;
+                }
+                set_provision_result(res, oid, ret);
+            }
+        }
+
+        for ( auto& c : created ) {
+            object_created(std::get<0>(c), std::get<1>(c), std::get<2>(c));
+        }
+        for ( auto& r : removed ) {
+            object_removed(r.first, r.second);
+        }
     }
-    add_status(context, ret);
+
+    add_status(context, TAI_STATUS_SUCCESS);
     return Status::OK;
 }
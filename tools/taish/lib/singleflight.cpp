@@ -0,0 +1,61 @@
+/**
+ * @file    singleflight.cpp
+ *
+ * @brief   This module implements the read coalescing of TAI gRPC server
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "taigrpc.hpp"
+
+tai::S_Attribute TAISingleFlight::run(tai_object_id_t oid, tai_attr_id_t id, const std::string& hint, std::function<tai::S_Attribute()> read, std::function<bool(const result_t&)> wait) {
+    auto key = std::make_tuple(oid, id, hint);
+    std::promise<tai::S_Attribute> p;
+    uint64_t seq;
+    {
+        std::unique_lock<std::mutex> lk(m_mtx);
+        auto it = m_calls.find(key);
+        if ( it != m_calls.end() ) {
+            auto result = it->second.result;
+            lk.unlock();
+            m_coalesced++;
+            if ( !wait(result) ) {
+                return nullptr;
+            }
+            return result.get();
+        }
+        seq = ++m_seq;
+        m_calls.emplace(key, call_t{seq, p.get_future().share()});
+    }
+
+    auto done = [&]() {
+        std::unique_lock<std::mutex> lk(m_mtx);
+        auto it = m_calls.find(key);
+        if ( it != m_calls.end() && it->second.seq == seq ) {
+            m_calls.erase(it);
+        }
+    };
+
+    try {
+        auto attr = read();
+        done();
+        p.set_value(attr);
+        return attr;
+    } catch (...) {
+        done();
+        p.set_exception(std::current_exception());
+        throw;
+    }
+}
+
+void TAISingleFlight::forget(tai_object_id_t oid) {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    auto it = m_calls.lower_bound(std::make_tuple(oid, static_cast<tai_attr_id_t>(0), std::string()));
+    while ( it != m_calls.end() && std::get<0>(it->first) == oid ) {
+        it = m_calls.erase(it);
+    }
+}
@@ -0,0 +1,145 @@
+/**
+ * @file    topology.cpp
+ *
+ * @brief   This module implements the topology snapshots of TAI gRPC server
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "taigrpc.hpp"
+#include <algorithm>
+
+using topology_response_ptr = std::shared_ptr<const taish::WatchTopologyResponse>;
+
+static void add_event(taish::WatchTopologyResponse* res, taish::TopologyEventType type, taish::TAIObjectType object_type, const std::string& location, tai_object_id_t oid, int index = 0, bool present = false) {
+    auto e = res->add_events();
+    e->set_type(type);
+    e->set_object_type(object_type);
+    e->set_location(location);
+    e->set_oid(oid);
+    e->set_index(index);
+    e->set_present(present);
+}
+
+static void add_interfaces(taish::WatchTopologyResponse* res, taish::TopologyEventType type, const tai_api_module_t& m) {
+    for ( auto& h : m.hostifs ) {
+        add_event(res, type, taish::HOSTIF, m.location, h.second, h.first);
+    }
+    for ( auto& n : m.netifs ) {
+        add_event(res, type, taish::NETIF, m.location, n.second, n.first);
+    }
+}
+
+static topology_response_ptr render_topology(const tai_topology_t& t) {
+    auto res = std::make_shared<taish::WatchTopologyResponse>();
+    res->set_version(t.version);
+    res->set_reset(true);
+    for ( auto& m : t.modules ) {
+        add_event(res.get(), taish::TOPOLOGY_ADD, taish::MODULE, m.location, m.id, 0, m.present);
+        add_interfaces(res.get(), taish::TOPOLOGY_ADD, m);
+    }
+    return res;
+}
+
+// appends the interfaces which are in a but not in b (or have another oid) as events of type
+static void diff_interfaces(taish::WatchTopologyResponse* res, taish::TopologyEventType type, taish::TAIObjectType object_type, const std::string& location, const std::map<int, tai_object_id_t>& a, const std::map<int, tai_object_id_t>& b) {
+    for ( auto& i : a ) {
+        auto it = b.find(i.first);
+        if ( it == b.end() || it->second != i.second ) {
+            add_event(res, type, object_type, location, i.second, i.first);
+        }
+    }
+}
+
+// the events which turn prev into next. interfaces are removed before and added after their module
+static topology_response_ptr diff_topology(const tai_topology_t& prev, const tai_topology_t& next) {
+    auto res = std::make_shared<taish::WatchTopologyResponse>();
+    res->set_version(next.version);
+    std::map<std::string, const tai_api_module_t*> before, after;
+    for ( auto& m : prev.modules ) {
+        before[m.location] = &m;
+    }
+    for ( auto& m : next.modules ) {
+        after[m.location] = &m;
+    }
+    for ( auto& b : before ) {
+        if ( after.find(b.first) == after.end() ) {
+            add_interfaces(res.get(), taish::TOPOLOGY_REMOVE, *b.second);
+            add_event(res.get(), taish::TOPOLOGY_REMOVE, taish::MODULE, b.first, b.second->id, 0, b.second->present);
+        }
+    }
+    for ( auto& a : after ) {
+        auto& m = *a.second;
+        auto it = before.find(a.first);
+        if ( it == before.end() ) {
+            add_event(res.get(), taish::TOPOLOGY_ADD, taish::MODULE, m.location, m.id, 0, m.present);
+            add_interfaces(res.get(), taish::TOPOLOGY_ADD, m);
+            continue;
+        }
+        auto& p = *it->second;
+        diff_interfaces(res.get(), taish::TOPOLOGY_REMOVE, taish::HOSTIF, m.location, p.hostifs, m.hostifs);
+        diff_interfaces(res.get(), taish::TOPOLOGY_REMOVE, taish::NETIF, m.location, p.netifs, m.netifs);
+        if ( p.id != m.id || p.present != m.present ) {
+            add_event(res.get(), taish::TOPOLOGY_UPDATE, taish::MODULE, m.location, m.id, 0, m.present);
+        }
+        diff_interfaces(res.get(), taish::TOPOLOGY_ADD, taish::HOSTIF, m.location, m.hostifs, p.hostifs);
+        diff_interfaces(res.get(), taish::TOPOLOGY_ADD, taish::NETIF, m.location, m.netifs, p.netifs);
+    }
+    return res;
+}
+
+// a watcher which doesn't keep up gets the whole topology instead of the changes it missed
+static void push(tai_topology_subscription_t* s, topology_response_ptr res, const tai_topology_t& t) {
+    {
+        std::unique_lock<std::mutex> lk(s->mtx);
+        if ( s->q.size() >= TAI_TOPOLOGY_MAX_QUEUE_SIZE ) {
+            s->q.clear();
+            res = render_topology(t);
+        }
+        s->q.emplace_back(res);
+        s->cv.notify_one();
+    }
+    if ( s->wakeup ) {
+        s->wakeup();
+    }
+}
+
+void TAITopology::publish(std::vector<tai_api_module_t> modules) {
+    for ( auto& m : modules ) {
+        if ( m.id == TAI_NULL_OBJECT_ID ) {
+            m.hostifs.clear();
+            m.netifs.clear();
+        }
+    }
+    std::sort(modules.begin(), modules.end(), [](const tai_api_module_t& a, const tai_api_module_t& b) {
+        return a.location < b.location;
+    });
+
+    std::unique_lock<std::mutex> lk(m_mtx);
+    auto next = std::make_shared<tai_topology_t>();
+    next->version = m_current->version + 1;
+    next->modules = std::move(modules);
+    auto res = diff_topology(*m_current, *next);
+    if ( res->events_size() == 0 ) {
+        return;
+    }
+    std::atomic_store(&m_current, std::shared_ptr<const tai_topology_t>(next));
+    for ( auto s : m_watchers ) {
+        push(s, res, *next);
+    }
+}
+
+void TAITopology::watch(tai_topology_subscription_t* s) {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    push(s, render_topology(*m_current), *m_current);
+    m_watchers.emplace_back(s);
+}
+
+void TAITopology::unwatch(tai_topology_subscription_t* s) {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    m_watchers.erase(std::remove(m_watchers.begin(), m_watchers.end(), s), m_watchers.end());
+}
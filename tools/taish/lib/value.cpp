@@ -0,0 +1,321 @@
+/**
+ * @file    value.cpp
+ *
+ * @brief   This module implements the conversion between TAI attribute values
+ *          and their typed protobuf representation
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "value.hpp"
+
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+template<typename L, typename R>
+static void to_repeated(const L& src, R* dst) {
+    dst->Reserve(src.count);
+    for ( uint32_t i = 0; i < src.count; i++ ) {
+        dst->Add(src.list[i]);
+    }
+}
+
+static tai_status_t to_typed(tai_attr_value_type_t type, tai_attr_value_type_t list_type, const tai_attribute_value_t* const src, taish::AttributeValue* const dst) {
+    switch (type) {
+    case TAI_ATTR_VALUE_TYPE_BOOLDATA:
+        dst->set_booldata(src->booldata);
+        break;
+    case TAI_ATTR_VALUE_TYPE_CHARDATA:
+        dst->set_chardata(std::string(src->chardata, strnlen(src->chardata, sizeof(src->chardata))));
+        break;
+    case TAI_ATTR_VALUE_TYPE_U8:
+        dst->set_u8(src->u8);
+        break;
+    case TAI_ATTR_VALUE_TYPE_S8:
+        dst->set_s8(src->s8);
+        break;
+    case TAI_ATTR_VALUE_TYPE_U16:
+        dst->set_u16(src->u16);
+        break;
+    case TAI_ATTR_VALUE_TYPE_S16:
+        dst->set_s16(src->s16);
+        break;
+    case TAI_ATTR_VALUE_TYPE_U32:
+        dst->set_u32(src->u32);
+        break;
+    case TAI_ATTR_VALUE_TYPE_S32:
+        dst->set_s32(src->s32);
+        break;
+    case TAI_ATTR_VALUE_TYPE_U64:
+        dst->set_u64(src->u64);
+        break;
+    case TAI_ATTR_VALUE_TYPE_S64:
+        dst->set_s64(src->s64);
+        break;
+    case TAI_ATTR_VALUE_TYPE_FLT:
+        dst->set_flt(src->flt);
+        break;
+    case TAI_ATTR_VALUE_TYPE_PTR:
+        dst->set_ptr(reinterpret_cast<uintptr_t>(src->ptr));
+        break;
+    case TAI_ATTR_VALUE_TYPE_OID:
+        dst->set_oid(src->oid);
+        break;
+    case TAI_ATTR_VALUE_TYPE_OBJLIST:
+        to_repeated(src->objlist, dst->mutable_objlist()->mutable_list());
+        break;
+    case TAI_ATTR_VALUE_TYPE_CHARLIST:
+        dst->set_charlist(std::string(src->charlist.list, src->charlist.count));
+        break;
+    case TAI_ATTR_VALUE_TYPE_U8LIST:
+        dst->set_u8list(std::string(reinterpret_cast<const char*>(src->u8list.list), src->u8list.count));
+        break;
+    case TAI_ATTR_VALUE_TYPE_S8LIST:
+        to_repeated(src->s8list, dst->mutable_s8list()->mutable_list());
+        break;
+    case TAI_ATTR_VALUE_TYPE_U16LIST:
+        to_repeated(src->u16list, dst->mutable_u16list()->mutable_list());
+        break;
+    case TAI_ATTR_VALUE_TYPE_S16LIST:
+        to_repeated(src->s16list, dst->mutable_s16list()->mutable_list());
+        break;
+    case TAI_ATTR_VALUE_TYPE_U32LIST:
+        to_repeated(src->u32list, dst->mutable_u32list()->mutable_list());
+        break;
+    case TAI_ATTR_VALUE_TYPE_S32LIST:
+        to_repeated(src->s32list, dst->mutable_s32list()->mutable_list());
+        break;
+    case TAI_ATTR_VALUE_TYPE_U64LIST:
+        to_repeated(src->u64list, dst->mutable_u64list()->mutable_list());
+        break;
+    case TAI_ATTR_VALUE_TYPE_S64LIST:
+        to_repeated(src->s64list, dst->mutable_s64list()->mutable_list());
+        break;
+    case TAI_ATTR_VALUE_TYPE_FLOATLIST:
+        to_repeated(src->floatlist, dst->mutable_floatlist()->mutable_list());
+        break;
+    case TAI_ATTR_VALUE_TYPE_U32RANGE:
+        dst->mutable_u32range()->set_min(src->u32range.min);
+        dst->mutable_u32range()->set_max(src->u32range.max);
+        break;
+    case TAI_ATTR_VALUE_TYPE_S32RANGE:
+        dst->mutable_s32range()->set_min(src->s32range.min);
+        dst->mutable_s32range()->set_max(src->s32range.max);
+        break;
+    case TAI_ATTR_VALUE_TYPE_OBJMAPLIST:
+        {
+            auto l = dst->mutable_objmaplist();
+            for ( uint32_t i = 0; i < src->objmaplist.count; i++ ) {
+                auto m = l->add_list();
+                m->set_key(src->objmaplist.list[i].key);
+                to_repeated(src->objmaplist.list[i].value, m->mutable_value());
+            }
+        }
+        break;
+    case TAI_ATTR_VALUE_TYPE_ATTRLIST:
+        {
+            auto l = dst->mutable_attrlist();
+            for ( uint32_t i = 0; i < src->attrlist.count; i++ ) {
+                auto ret = to_typed(list_type, TAI_ATTR_VALUE_TYPE_UNSPECIFIED, &src->attrlist.list[i], l->add_list());
+                if ( ret != TAI_STATUS_SUCCESS ) {
+                    return ret;
+                }
+            }
+        }
+        break;
+    default:
+        return TAI_STATUS_NOT_SUPPORTED;
+    }
+    return TAI_STATUS_SUCCESS;
+}
+
+tai_status_t convert_attribute_value(const tai_attr_metadata_t* const meta, const tai_attribute_value_t* const src, taish::AttributeValue* const dst) {
+    if ( meta == nullptr || src == nullptr || dst == nullptr ) {
+        return TAI_STATUS_INVALID_PARAMETER;
+    }
+    return to_typed(meta->attrvaluetype, meta->attrlistvaluetype, src, dst);
+}
+
+// tai_value_builder_t fills a tai_attribute_value_t whose lists point to the buffers owned by the builder.
+// the value is only valid while the builder is alive; tai::Attribute makes its own deep copy
+struct tai_value_builder_t {
+    std::vector<std::shared_ptr<void>> buffers;
+
+    template<typename T>
+    T* alloc(size_t n) {
+        auto p = std::shared_ptr<T>(new T[std::max<size_t>(n, 1)](), std::default_delete<T[]>());
+        buffers.emplace_back(p);
+        return p.get();
+    }
+
+    template<typename L, typename R>
+    void from_repeated(const R& src, L* dst) {
+        using T = typename std::remove_pointer<decltype(dst->list)>::type;
+        dst->count = src.size();
+        dst->list = alloc<T>(src.size());
+        std::copy(src.begin(), src.end(), dst->list);
+    }
+
+    tai_status_t build(tai_attr_value_type_t type, tai_attr_value_type_t list_type, const taish::AttributeValue& src, tai_attribute_value_t* const dst) {
+        using V = taish::AttributeValue;
+        auto expect = [&](V::ValueCase c) { return src.value_case() == c; };
+        switch (type) {
+        case TAI_ATTR_VALUE_TYPE_BOOLDATA:
+            if ( !expect(V::kBooldata) ) break;
+            dst->booldata = src.booldata();
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_CHARDATA:
+            if ( !expect(V::kChardata) || src.chardata().size() >= sizeof(dst->chardata) ) break;
+            std::memset(dst->chardata, 0, sizeof(dst->chardata));
+            std::memcpy(dst->chardata, src.chardata().data(), src.chardata().size());
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_U8:
+            if ( !expect(V::kU8) ) break;
+            dst->u8 = src.u8();
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_S8:
+            if ( !expect(V::kS8) ) break;
+            dst->s8 = src.s8();
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_U16:
+            if ( !expect(V::kU16) ) break;
+            dst->u16 = src.u16();
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_S16:
+            if ( !expect(V::kS16) ) break;
+            dst->s16 = src.s16();
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_U32:
+            if ( !expect(V::kU32) ) break;
+            dst->u32 = src.u32();
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_S32:
+            if ( !expect(V::kS32) ) break;
+            dst->s32 = src.s32();
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_U64:
+            if ( !expect(V::kU64) ) break;
+            dst->u64 = src.u64();
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_S64:
+            if ( !expect(V::kS64) ) break;
+            dst->s64 = src.s64();
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_FLT:
+            if ( !expect(V::kFlt) ) break;
+            dst->flt = src.flt();
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_PTR:
+            if ( !expect(V::kPtr) ) break;
+            dst->ptr = reinterpret_cast<tai_pointer_t>(static_cast<uintptr_t>(src.ptr()));
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_OID:
+            if ( !expect(V::kOid) ) break;
+            dst->oid = src.oid();
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_OBJLIST:
+            if ( !expect(V::kObjlist) ) break;
+            from_repeated(src.objlist().list(), &dst->objlist);
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_CHARLIST:
+            if ( !expect(V::kCharlist) ) break;
+            from_repeated(src.charlist(), &dst->charlist);
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_U8LIST:
+            if ( !expect(V::kU8List) ) break;
+            from_repeated(src.u8list(), &dst->u8list);
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_S8LIST:
+            if ( !expect(V::kS8List) ) break;
+            from_repeated(src.s8list().list(), &dst->s8list);
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_U16LIST:
+            if ( !expect(V::kU16List) ) break;
+            from_repeated(src.u16list().list(), &dst->u16list);
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_S16LIST:
+            if ( !expect(V::kS16List) ) break;
+            from_repeated(src.s16list().list(), &dst->s16list);
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_U32LIST:
+            if ( !expect(V::kU32List) ) break;
+            from_repeated(src.u32list().list(), &dst->u32list);
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_S32LIST:
+            if ( !expect(V::kS32List) ) break;
+            from_repeated(src.s32list().list(), &dst->s32list);
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_U64LIST:
+            if ( !expect(V::kU64List) ) break;
+            from_repeated(src.u64list().list(), &dst->u64list);
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_S64LIST:
+            if ( !expect(V::kS64List) ) break;
+            from_repeated(src.s64list().list(), &dst->s64list);
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_FLOATLIST:
+            if ( !expect(V::kFloatlist) ) break;
+            from_repeated(src.floatlist().list(), &dst->floatlist);
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_U32RANGE:
+            if ( !expect(V::kU32Range) ) break;
+            dst->u32range.min = src.u32range().min();
+            dst->u32range.max = src.u32range().max();
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_S32RANGE:
+            if ( !expect(V::kS32Range) ) break;
+            dst->s32range.min = src.s32range().min();
+            dst->s32range.max = src.s32range().max();
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_OBJMAPLIST:
+            {
+                if ( !expect(V::kObjmaplist) ) break;
+                auto& l = src.objmaplist().list();
+                dst->objmaplist.count = l.size();
+                dst->objmaplist.list = alloc<tai_object_map_t>(l.size());
+                for ( int i = 0; i < l.size(); i++ ) {
+                    dst->objmaplist.list[i].key = l[i].key();
+                    from_repeated(l[i].value(), &dst->objmaplist.list[i].value);
+                }
+            }
+            return TAI_STATUS_SUCCESS;
+        case TAI_ATTR_VALUE_TYPE_ATTRLIST:
+            {
+                if ( !expect(V::kAttrlist) ) break;
+                auto& l = src.attrlist().list();
+                dst->attrlist.count = l.size();
+                dst->attrlist._alloced = l.size();
+                dst->attrlist.list = alloc<tai_attribute_value_t>(l.size());
+                for ( int i = 0; i < l.size(); i++ ) {
+                    auto ret = build(list_type, TAI_ATTR_VALUE_TYPE_UNSPECIFIED, l[i], &dst->attrlist.list[i]);
+                    if ( ret != TAI_STATUS_SUCCESS ) {
+                        return ret;
+                    }
+                }
+            }
+            return TAI_STATUS_SUCCESS;
+        default:
+            return TAI_STATUS_NOT_SUPPORTED;
+        }
+        return TAI_STATUS_INVALID_ATTR_VALUE_0;
+    }
+};
+
+tai::S_Attribute convert_attribute_value(const tai_attr_metadata_t* const meta, const taish::AttributeValue& src) {
+    if ( meta == nullptr ) {
+        throw tai::Exception(TAI_STATUS_INVALID_PARAMETER);
+    }
+    tai_value_builder_t builder;
+    tai_attribute_t attr{.id = meta->attrid};
+    auto ret = builder.build(meta->attrvaluetype, meta->attrlistvaluetype, src, &attr.value);
+    if ( ret != TAI_STATUS_SUCCESS ) {
+        throw tai::Exception(ret);
+    }
+    return std::make_shared<tai::Attribute>(meta, &attr);
+}
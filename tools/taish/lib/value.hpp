@@ -0,0 +1,30 @@
+/**
+ * @file    value.hpp
+ *
+ * @brief   This module defines the conversion between TAI attribute values
+ *          and their typed protobuf representation
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef __TAISH_VALUE_HPP__
+#define __TAISH_VALUE_HPP__
+
+#include "tai.h"
+#include "taimetadata.h"
+#include "taish.pb.h"
+#include "attribute.hpp"
+
+// converts src into dst without going through the string representation.
+// returns TAI_STATUS_NOT_SUPPORTED for the value types which can't cross the wire (e.g. notification)
+tai_status_t convert_attribute_value(const tai_attr_metadata_t* const meta, const tai_attribute_value_t* const src, taish::AttributeValue* const dst);
+
+// builds an attribute from its typed representation.
+// throws tai::Exception when src doesn't match the value type of meta
+tai::S_Attribute convert_attribute_value(const tai_attr_metadata_t* const meta, const taish::AttributeValue& src);
+
+#endif // __TAISH_VALUE_HPP__
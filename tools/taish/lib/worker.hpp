@@ -0,0 +1,97 @@
+/**
+ * @file    worker.hpp
+ *
+ * @brief   This module defines a thread pool which executes TAI adapter calls
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef __TAISH_WORKER_HPP__
+#define __TAISH_WORKER_HPP__
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <vector>
+#include <functional>
+
+class TAIWorkerPool {
+    public:
+        using task = std::function<void()>;
+
+        TAIWorkerPool(int num) {
+            if ( num < 1 ) {
+                num = 1;
+            }
+            for ( int i = 0; i < num; i++ ) {
+                m_threads.emplace_back(&TAIWorkerPool::loop, this);
+            }
+        }
+
+        ~TAIWorkerPool() {
+            stop();
+        }
+
+        // returns -1 when the pool is already stopped
+        int push(task t) {
+            {
+                std::unique_lock<std::mutex> lk(m_mtx);
+                if ( m_stop ) {
+                    return -1;
+                }
+                m_q.push(std::move(t));
+            }
+            m_cv.notify_one();
+            return 0;
+        }
+
+        // runs the queued tasks and joins the threads
+        void stop() {
+            {
+                std::unique_lock<std::mutex> lk(m_mtx);
+                if ( m_stop ) {
+                    return;
+                }
+                m_stop = true;
+            }
+            m_cv.notify_all();
+            for ( auto& t : m_threads ) {
+                t.join();
+            }
+            m_threads.clear();
+        }
+
+        int size() {
+            return m_threads.size();
+        }
+
+    private:
+        void loop() {
+            while (true) {
+                task t;
+                {
+                    std::unique_lock<std::mutex> lk(m_mtx);
+                    m_cv.wait(lk, [&]{ return m_stop || !m_q.empty(); });
+                    if ( m_q.empty() ) {
+                        return;
+                    }
+                    t = std::move(m_q.front());
+                    m_q.pop();
+                }
+                t();
+            }
+        }
+
+        std::mutex m_mtx;
+        std::condition_variable m_cv;
+        std::queue<task> m_q;
+        std::vector<std::thread> m_threads;
+        bool m_stop = false;
+};
+
+#endif // __TAISH_WORKER_HPP__
@@ -0,0 +1,224 @@
+/**
+ * @file    config_cache.cpp
+ *
+ * @brief   This module implements the compiled config cache of taish server
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "config_cache.hpp"
+#include "value.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+uint64_t tai_config_hash(const void* data, size_t size, uint64_t h) {
+    auto p = static_cast<const unsigned char*>(data);
+    for ( size_t i = 0; i < size; i++ ) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static void put_varint(std::string& buf, uint64_t v) {
+    while ( v >= 0x80 ) {
+        buf.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    buf.push_back(static_cast<char>(v));
+}
+
+static void put_string(std::string& buf, const std::string& s) {
+    put_varint(buf, s.size());
+    buf.append(s);
+}
+
+// throws std::runtime_error when buf ends in the middle
+class reader {
+    public:
+        reader(const std::string& buf) : m_buf(buf) {}
+        uint64_t varint() {
+            uint64_t v = 0;
+            for ( int shift = 0; shift < 64; shift += 7 ) {
+                if ( m_pos >= m_buf.size() ) {
+                    throw std::runtime_error("truncated varint");
+                }
+                auto c = static_cast<unsigned char>(m_buf[m_pos++]);
+                v |= static_cast<uint64_t>(c & 0x7f) << shift;
+                if ( (c & 0x80) == 0 ) {
+                    return v;
+                }
+            }
+            throw std::runtime_error("invalid varint");
+        }
+        std::string string() {
+            auto size = varint();
+            if ( size > m_buf.size() - m_pos ) {
+                throw std::runtime_error("truncated string");
+            }
+            auto s = m_buf.substr(m_pos, size);
+            m_pos += size;
+            return s;
+        }
+        bool end() const {
+            return m_pos == m_buf.size();
+        }
+    private:
+        const std::string& m_buf;
+        size_t m_pos = sizeof(TAI_CONFIG_CACHE_MAGIC);
+};
+
+static int put_attributes(std::string& buf, tai_object_type_t type, int index, const std::vector<tai::S_Attribute>& attrs) {
+    put_varint(buf, type);
+    put_varint(buf, index);
+    put_varint(buf, attrs.size());
+    for ( auto& a : attrs ) {
+        taish::AttributeValue v;
+        if ( convert_attribute_value(a->metadata(), &a->raw()->value, &v) != TAI_STATUS_SUCCESS ) {
+            return -1;
+        }
+        put_varint(buf, a->raw()->id);
+        put_string(buf, v.SerializeAsString());
+    }
+    return 0;
+}
+
+int TAIConfigCache::open(const std::string& path, uint64_t key, tai_metadata_getter_t getter) {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    m_path = path;
+    m_key = key;
+    m_modules.clear();
+    try {
+        return load(getter);
+    } catch ( std::exception& ) {
+        m_modules.clear();
+        return -1;
+    }
+}
+
+int TAIConfigCache::load(tai_metadata_getter_t getter) {
+    auto fp = fopen(m_path.c_str(), "rb");
+    if ( fp == nullptr ) {
+        return -1;
+    }
+    std::string buf;
+    char chunk[4096];
+    size_t n;
+    while ( (n = fread(chunk, 1, sizeof(chunk), fp)) > 0 ) {
+        buf.append(chunk, n);
+    }
+    fclose(fp);
+    if ( buf.size() < sizeof(TAI_CONFIG_CACHE_MAGIC) || memcmp(buf.data(), TAI_CONFIG_CACHE_MAGIC, sizeof(TAI_CONFIG_CACHE_MAGIC)) != 0 ) {
+        return -1;
+    }
+    reader r(buf);
+    if ( r.varint() != m_key ) {
+        return -1;
+    }
+    while ( !r.end() ) {
+        auto location = r.string();
+        auto module = std::make_shared<tai_compiled_module_t>();
+        auto num = r.varint();
+        for ( uint64_t i = 0; i < num; i++ ) {
+            auto type = static_cast<tai_object_type_t>(r.varint());
+            int index = r.varint();
+            std::vector<tai::S_Attribute>* attrs;
+            switch ( type ) {
+            case TAI_OBJECT_TYPE_MODULE:
+                attrs = &module->module;
+                break;
+            case TAI_OBJECT_TYPE_HOSTIF:
+                attrs = &module->hostifs[index];
+                break;
+            case TAI_OBJECT_TYPE_NETWORKIF:
+                attrs = &module->netifs[index];
+                break;
+            default:
+                throw std::runtime_error("invalid object type");
+            }
+            auto count = r.varint();
+            for ( uint64_t j = 0; j < count; j++ ) {
+                auto meta = getter(type, location, r.varint());
+                taish::AttributeValue v;
+                if ( meta == nullptr || !v.ParseFromString(r.string()) ) {
+                    throw std::runtime_error("invalid attribute");
+                }
+                // throws tai::Exception when the value doesn't match the metadata
+                attrs->emplace_back(convert_attribute_value(meta, v));
+            }
+        }
+        m_modules[location] = module;
+    }
+    return m_modules.size();
+}
+
+tai_compiled_module_ptr TAIConfigCache::find(const std::string& location) {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    auto it = m_modules.find(location);
+    if ( it == m_modules.end() ) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+void TAIConfigCache::insert(const std::string& location, tai_compiled_module_ptr module) {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    if ( m_path == "" ) {
+        return;
+    }
+    m_modules[location] = module;
+    m_dirty = true;
+}
+
+int TAIConfigCache::save() {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    if ( !m_dirty ) {
+        return 0;
+    }
+    std::string buf(TAI_CONFIG_CACHE_MAGIC, sizeof(TAI_CONFIG_CACHE_MAGIC));
+    put_varint(buf, m_key);
+    int num = 0;
+    for ( auto& m : m_modules ) {
+        std::string module;
+        auto& c = *m.second;
+        put_string(module, m.first);
+        put_varint(module, 1 + c.hostifs.size() + c.netifs.size());
+        auto ret = put_attributes(module, TAI_OBJECT_TYPE_MODULE, 0, c.module);
+        for ( auto& h : c.hostifs ) {
+            ret |= put_attributes(module, TAI_OBJECT_TYPE_HOSTIF, h.first, h.second);
+        }
+        for ( auto& n : c.netifs ) {
+            ret |= put_attributes(module, TAI_OBJECT_TYPE_NETWORKIF, n.first, n.second);
+        }
+        if ( ret == 0 ) {
+            buf.append(module);
+            num++;
+        }
+    }
+    // the file is replaced at once so that a crash while writing doesn't leave a broken cache
+    auto tmp = m_path + ".tmp";
+    auto fp = fopen(tmp.c_str(), "wb");
+    if ( fp == nullptr ) {
+        return -1;
+    }
+    auto written = fwrite(buf.data(), buf.size(), 1, fp) == 1;
+    if ( fclose(fp) != 0 || !written || rename(tmp.c_str(), m_path.c_str()) != 0 ) {
+        remove(tmp.c_str());
+        return -1;
+    }
+    m_dirty = false;
+    return num;
+}
+
+void TAIConfigCache::reset(uint64_t key) {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    m_key = key;
+    m_modules.clear();
+    m_dirty = m_path != "";
+}
@@ -0,0 +1,79 @@
+/**
+ * @file    config_cache.hpp
+ *
+ * @brief   This module defines the compiled config cache of taish server
+ *
+ * @copyright Copyright (c) 2018 Nippon Telegraph and Telephone Corporation
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifndef __TAISH_CONFIG_CACHE_HPP__
+#define __TAISH_CONFIG_CACHE_HPP__
+
+#include "tai.h"
+#include "taimetadata.h"
+#include "attribute.hpp"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// the attributes the config gives to a module and its interfaces. the interfaces are keyed by their index
+struct tai_compiled_module_t {
+    std::vector<tai::S_Attribute> module;
+    std::map<int, std::vector<tai::S_Attribute>> hostifs;
+    std::map<int, std::vector<tai::S_Attribute>> netifs;
+};
+
+using tai_compiled_module_ptr = std::shared_ptr<const tai_compiled_module_t>;
+
+// the metadata of an attribute of the object type at the location. nullptr when there is no such attribute
+using tai_metadata_getter_t = std::function<const tai_attr_metadata_t*(tai_object_type_t type, const std::string& location, tai_attr_id_t id)>;
+
+// the first bytes of a config cache
+const char TAI_CONFIG_CACHE_MAGIC[] = "TAICFG1";
+
+const uint64_t TAI_CONFIG_HASH_INIT = 0xcbf29ce484222325ULL;
+
+// FNV-1a. unlike std::hash, the value doesn't change across builds, so it can key a file
+uint64_t tai_config_hash(const void* data, size_t size, uint64_t h = TAI_CONFIG_HASH_INIT);
+
+inline uint64_t tai_config_hash(const std::string& s, uint64_t h = TAI_CONFIG_HASH_INIT) {
+    return tai_config_hash(s.data(), s.size(), h);
+}
+
+// TAIConfigCache keeps the config compiled into TAI attributes on disk so that a warm start
+// doesn't resolve the attribute names nor deserialize the values again.
+// the file starts with TAI_CONFIG_CACHE_MAGIC and the key. each module follows as its location
+// and the number of its objects. an object is its type, its index and the number of its attributes.
+// an attribute is its id and its value as taish.AttributeValue. the integers are varints and the
+// strings and the values are a varint length followed by the bytes
+class TAIConfigCache {
+    public:
+        // reads the modules compiled for key. returns the number of modules read, or -1 when
+        // the file is missing, broken or compiled for another key. the cache is usable either way
+        int open(const std::string& path, uint64_t key, tai_metadata_getter_t getter);
+        // nullptr when the module is not compiled yet or the cache is not open
+        tai_compiled_module_ptr find(const std::string& location);
+        void insert(const std::string& location, tai_compiled_module_ptr module);
+        // writes the modules when one was inserted since the last save. the modules which have
+        // a value that can't be written are left out. returns the number of modules written
+        int save();
+        // drops the modules compiled for the previous key, e.g. when the config is reloaded
+        void reset(uint64_t key);
+    private:
+        int load(tai_metadata_getter_t getter);
+        std::string m_path;
+        uint64_t m_key = 0;
+        bool m_dirty = false;
+        std::map<std::string, tai_compiled_module_ptr> m_modules;
+        std::mutex m_mtx;
+};
+
+#endif // __TAISH_CONFIG_CACHE_HPP__
@@ -13,21 +13,35 @@
 #include <thread>
 #include <queue>
 #include <mutex>
+#include <future>
 #include <iostream>
 #include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <cstring>
 #include "unistd.h"
 #include <cstdlib>
 #include <sstream>
+#include <iomanip>
 #include <fstream>
 #include <cstdarg>
+#include <csignal>
 
 #include "json.hpp"
 
 #include "taigrpc.hpp"
 #include "taimetadata.h"
+#include "worker.hpp"
+#include "config_cache.hpp"
 
 #include "logger.hpp"
 #include "attribute.hpp"
+#include "name.hpp"
 
 using grpc::ServerBuilder;
 using grpc::ServerContext;
@@ -36,10 +50,33 @@ using json = nlohmann::json;
 
 static const std::string TAI_RPC_DEFAULT_IP = "0.0.0.0";
 static const uint16_t TAI_RPC_DEFAULT_PORT = 50051;
+static const int TAI_RPC_DEFAULT_NUM_POLLERS = 1;
+static const int TAI_RPC_DEFAULT_NUM_WORKERS = 4;
+// the module_presence calls which arrive within this window of the first one are applied at once
+static const auto TAI_PRESENCE_DEBOUNCE = std::chrono::milliseconds(50);
+
+struct grpc_option_t {
+    std::string addr;
+    std::string unix_path; // Unix domain socket to listen on in addition to addr. empty means disabled
+    bool async;
+    int num_pollers;
+    int num_workers;
+    tai_service_option_t service;
+    std::string stats_addr; // where to serve the stats text. empty means disabled
+};
 
 tai_api_method_table_t g_api;
+TAIRecorder g_recorder;
+TAITopology g_topology;
+std::atomic<TAIServiceImpl*> g_service{nullptr}; // set by start_grpc_server()
+TAIConfigCache g_config_cache;
+
+std::string g_journal_file; // empty means the journal is disabled
+json g_journal = json::object(); // the modules journaled before the restart, keyed by location
+bool g_journal_dirty = false; // the objects changed since the journal was written. guarded by m
 
 int event_fd;
+int journal_fd; // object_update wakes the main loop up through it to write the journal
 std::queue<std::pair<bool, std::string>> q;
 std::mutex m;
 
@@ -70,17 +107,13 @@ static int load_config(const json& config, std::vector<tai::S_Attribute>& list,
             if ( info == nullptr ) {
                 throw std::runtime_error("failed to get object info");
             }
-            ret = tai_deserialize_enum(a.key().c_str(), info->enummetadata, &attr_id, &option);
+            ret = resolve_attr_name(info->enummetadata, a.key(), &attr_id, &option);
         } else {
             switch ( t ) {
             case TAI_OBJECT_TYPE_MODULE:
-                ret = tai_deserialize_module_attr(a.key().c_str(), &attr_id, &option);
-                break;
             case TAI_OBJECT_TYPE_HOSTIF:
-                ret = tai_deserialize_host_interface_attr(a.key().c_str(), &attr_id, &option);
-                break;
             case TAI_OBJECT_TYPE_NETWORKIF:
-                ret = tai_deserialize_network_interface_attr(a.key().c_str(), &attr_id, &option);
+                ret = resolve_attr_name(t, a.key(), &attr_id, &option);
                 break;
             default:
                 throw std::runtime_error("unsupported object type");
@@ -104,17 +137,132 @@ static int load_config(const json& config, std::vector<tai::S_Attribute>& list,
     return 0;
 }
 
+// "taish": { "cache": { "<module|hostif|netif>": { "<attribute name>": <max-age in milliseconds>, ... } } }
+static void load_cache_policy(const json& config, tai_cache_policy_t& policy) {
+    auto t = config.find("taish");
+    if ( t == config.end() || !t->is_object() ) {
+        return;
+    }
+    auto c = t->find("cache");
+    if ( c == t->end() ) {
+        return;
+    }
+    if ( !c->is_object() ) {
+        throw std::runtime_error("cache must be an object");
+    }
+    static const std::map<std::string, tai_object_type_t> types = {
+        {"module", TAI_OBJECT_TYPE_MODULE},
+        {"hostif", TAI_OBJECT_TYPE_HOSTIF},
+        {"netif", TAI_OBJECT_TYPE_NETWORKIF},
+    };
+    for ( auto& o : c->items() ) {
+        auto type = types.find(o.key());
+        if ( type == types.end() || !o.value().is_object() ) {
+            throw std::runtime_error("invalid object type: " + o.key());
+        }
+        for ( auto& a : o.value().items() ) {
+            if ( !a.value().is_number_unsigned() ) {
+                throw std::runtime_error("max-age of " + a.key() + " must be a positive number");
+            }
+            policy[std::make_pair(type->second, a.key())] = std::chrono::milliseconds(a.value().get<uint64_t>());
+        }
+    }
+}
+
+static tai_rate_limit_t load_rate_limit(const json& config, const std::string& name) {
+    auto l = config.find(name);
+    if ( l == config.end() ) {
+        return tai_rate_limit_t{};
+    }
+    auto rate = l->find("rate");
+    if ( !l->is_object() || rate == l->end() || !rate->is_number() || rate->get<double>() <= 0 ) {
+        throw std::runtime_error(name + " must have a positive rate");
+    }
+    // the burst is one second worth of calls by default
+    tai_rate_limit_t limit{rate->get<double>(), std::max(1.0, rate->get<double>())};
+    auto burst = l->find("burst");
+    if ( burst != l->end() ) {
+        if ( !burst->is_number() || burst->get<double>() < 1 ) {
+            throw std::runtime_error("burst of " + name + " must be 1 or more");
+        }
+        limit.burst = burst->get<double>();
+    }
+    return limit;
+}
+
+// "taish": { "admission": { "<peer|module>": { "rate": <calls per second>, "burst": <calls> } } }
+static void load_admission_policy(const json& config, tai_admission_policy_t& policy) {
+    auto t = config.find("taish");
+    if ( t == config.end() || !t->is_object() ) {
+        return;
+    }
+    auto a = t->find("admission");
+    if ( a == t->end() ) {
+        return;
+    }
+    if ( !a->is_object() ) {
+        throw std::runtime_error("admission must be an object");
+    }
+    policy.peer = load_rate_limit(*a, "peer");
+    policy.module = load_rate_limit(*a, "module");
+}
+
+// the attributes of the interfaces given by the config, keyed by the interface index
+using interface_configs_t = std::map<int, std::vector<tai::S_Attribute>>;
+
+static interface_configs_t load_interface_configs(const json& config, const std::string& key, tai_object_type_t t, const std::string& location) {
+    interface_configs_t configs;
+    auto c = config.find(key);
+    if ( c == config.end() || !c->is_object() ) {
+        return configs;
+    }
+    for ( auto& i : c->items() ) {
+        char* end;
+        auto index = strtoul(i.key().c_str(), &end, 10);
+        if ( i.key().empty() || *end != '\0' ) {
+            continue;
+        }
+        load_config(i.value(), configs[index], t, location);
+    }
+    return configs;
+}
+
+// writes a line at once so that the lines of the modules brought up in parallel don't mix
+static void log_line(const std::stringstream& ss) {
+    std::cout << ss.str() + "\n" << std::flush;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
 class module {
     public:
-        module(std::string location, const json& config, bool auto_creation) : m_id(0), m_location(location) {
+        // use_cache: config is the one in the config file, which the config cache has compiled
+        // warm_restart: the module is journaled and the adapter reattaches to it. see TAI_MODULE_ATTR_WARM_RESTART
+        module(std::string location, const json& config, bool auto_creation, bool use_cache = true, bool warm_restart = false) : m_id(0), m_location(location) {
             std::vector<tai::S_Attribute> list;
             std::vector<tai_attribute_t> raw_list;
             tai_attribute_t attr;
+            std::stringstream ss;
 
             if (!auto_creation) {
                 return;
             }
 
+            // the interface configs are resolved while the adapter creates the module, unless
+            // the config cache has them already
+            auto compiled = use_cache ? g_config_cache.find(location) : nullptr;
+            std::future<std::shared_ptr<tai_compiled_module_t>> interfaces;
+            if ( compiled == nullptr ) {
+                interfaces = std::async(std::launch::async, [&]() {
+                    auto c = std::make_shared<tai_compiled_module_t>();
+                    c->hostifs = load_interface_configs(config, "hostif", TAI_OBJECT_TYPE_HOSTIF, location);
+                    c->netifs = load_interface_configs(config, "netif", TAI_OBJECT_TYPE_NETWORKIF, location);
+                    return c;
+                });
+            }
+
             attr.id = TAI_MODULE_ATTR_LOCATION;
             attr.value.charlist.count = location.size();
             attr.value.charlist.list = (char*)location.c_str();
@@ -125,19 +273,35 @@ class module {
             }
             list.push_back(std::make_shared<tai::Attribute>(meta, &attr));
 
-            load_config(config, list, TAI_OBJECT_TYPE_MODULE, location);
+            if ( compiled != nullptr ) {
+                list.insert(list.end(), compiled->module.begin(), compiled->module.end());
+            } else {
+                load_config(config, list, TAI_OBJECT_TYPE_MODULE, location);
+            }
 
             for ( auto& a : list ) {
                 raw_list.push_back(*a->raw());
             }
+            if ( warm_restart ) {
+                attr.id = TAI_MODULE_ATTR_WARM_RESTART;
+                attr.value.booldata = true;
+                raw_list.push_back(attr);
+            }
 
-            auto status = g_api.module_api->create_module(&m_id, raw_list.size(), raw_list.data());
+            // the adapter calls go through the service so that they are serialized against the calls of
+            // the clients as well. only the config resolution runs in parallel
+            auto service = g_service.load();
+            auto start = std::chrono::steady_clock::now();
+            auto status = service->create(TAI_OBJECT_TYPE_MODULE, TAI_NULL_OBJECT_ID, raw_list, &m_id);
             if ( status != TAI_STATUS_SUCCESS ) {
-                std::cout << "failed to create module whose location is " << location << ", err: " << status << std::endl;
+                ss << "failed to create module whose location is " << location << ", err: " << status;
+                log_line(ss);
                 return;
             }
+            module_ms = elapsed_ms(start);
 
-            std::cout << "created module id: 0x" << std::hex << m_id << std::endl;
+            ss << "created module id: 0x" << std::hex << m_id;
+            log_line(ss);
 
             raw_list.clear();
 
@@ -145,14 +309,32 @@ class module {
             raw_list.push_back(attr);
             attr.id = TAI_MODULE_ATTR_NUM_NETWORK_INTERFACES;
             raw_list.push_back(attr);
-            status = g_api.module_api->get_module_attributes(m_id, raw_list.size(), raw_list.data());
+            status = service->get_module_attributes(m_id, raw_list);
             if ( status != TAI_STATUS_SUCCESS ) {
                 throw std::runtime_error("faile to get attribute");
             }
-            std::cout << "num hostif: " << raw_list[0].value.u32 << std::endl;
-            std::cout << "num netif: " << raw_list[1].value.u32 << std::endl;
-            create_hostif(raw_list[0].value.u32, config, location);
-            create_netif(raw_list[1].value.u32, config, location);
+            ss.str("");
+            ss << "num hostif: " << std::dec << raw_list[0].value.u32;
+            log_line(ss);
+            ss.str("");
+            ss << "num netif: " << raw_list[1].value.u32;
+            log_line(ss);
+            config_cached = compiled != nullptr;
+            if ( compiled == nullptr ) {
+                auto c = interfaces.get();
+                c->module.assign(list.begin() + 1, list.end()); // without the location
+                if ( use_cache ) {
+                    g_config_cache.insert(location, c);
+                }
+                compiled = c;
+            }
+            start = std::chrono::steady_clock::now();
+            create_hostif(raw_list[0].value.u32, compiled->hostifs);
+            hostif_ms = elapsed_ms(start);
+            start = std::chrono::steady_clock::now();
+            create_netif(raw_list[1].value.u32, compiled->netifs);
+            netif_ms = elapsed_ms(start);
+            applied = config.is_object() ? config : json::object();
         }
 
         const std::string& location() {
@@ -172,11 +354,20 @@ class module {
         std::map<int, tai_object_id_t> hostifs;
 
         bool present;
+
+        // the config applied to the module and its interfaces. null when taish_server didn't create them
+        json applied;
+
+        // the time the adapter took to create the module and its interfaces
+        double module_ms = 0;
+        double hostif_ms = 0;
+        double netif_ms = 0;
+        bool config_cached = false; // the config was read from the config cache
     private:
         tai_object_id_t m_id;
         std::string m_location;
-        int create_hostif(uint32_t num, const json& config, const std::string& location);
-        int create_netif(uint32_t num, const json& config, const std::string& location);
+        int create_hostif(uint32_t num, const interface_configs_t& configs);
+        int create_netif(uint32_t num, const interface_configs_t& configs);
 };
 
 void module_presence(bool present, char* location) {
@@ -186,8 +377,7 @@ void module_presence(bool present, char* location) {
     v = write(event_fd, &v, sizeof(uint64_t));
 }
 
-int module::create_hostif(uint32_t num, const json& config, const std::string& location) {
-    auto c = config.find("hostif");
+int module::create_hostif(uint32_t num, const interface_configs_t& configs) {
     for ( uint32_t i = 0; i < num; i++ ) {
         tai_object_id_t id;
         std::vector<tai::S_Attribute> list;
@@ -202,32 +392,28 @@ int module::create_hostif(uint32_t num, const json& config, const std::string& l
             throw std::runtime_error("failed to get metadata for index attribute");
         }
         list.push_back(std::make_shared<tai::Attribute>(meta, &attr));
-
-        if ( c != config.end() && c->is_object() ) {
-            std::stringstream ss;
-            ss << i;
-            auto cc = c->find(ss.str());
-            if ( cc != c->end() ) {
-                load_config(*cc, list, TAI_OBJECT_TYPE_HOSTIF, location);
-            }
+        auto config = configs.find(i);
+        if ( config != configs.end() ) {
+            list.insert(list.end(), config->second.begin(), config->second.end());
         }
 
         for ( auto& a : list ) {
             raw_list.push_back(*a->raw());
         }
 
-        auto status = g_api.hostif_api->create_host_interface(&id, m_id, raw_list.size(), raw_list.data());
+        auto status = g_service.load()->create(TAI_OBJECT_TYPE_HOSTIF, m_id, raw_list, &id);
         if ( status != TAI_STATUS_SUCCESS ) {
             throw std::runtime_error("failed to create host interface");
         }
-        std::cout << "hostif: 0x" << std::hex << id << std::endl;
+        std::stringstream ss;
+        ss << "hostif: 0x" << std::hex << id;
+        log_line(ss);
         hostifs[i] = id;
     }
     return 0;
 }
 
-int module::create_netif(uint32_t num, const json& config, const std::string& location) {
-    auto c = config.find("netif");
+int module::create_netif(uint32_t num, const interface_configs_t& configs) {
     for ( uint32_t i = 0; i < num; i++ ) {
         tai_object_id_t id;
         std::vector<tai::S_Attribute> list;
@@ -242,50 +428,129 @@ int module::create_netif(uint32_t num, const json& config, const std::string& lo
             throw std::runtime_error("failed to get metadata for index attribute");
         }
         list.push_back(std::make_shared<tai::Attribute>(meta, &attr));
-
-        if ( c != config.end() && c->is_object() ) {
-            std::stringstream ss;
-            ss << i;
-            auto cc = c->find(ss.str());
-            if ( cc != c->end() ) {
-                load_config(*cc, list, TAI_OBJECT_TYPE_NETWORKIF, location);
-            }
+        auto config = configs.find(i);
+        if ( config != configs.end() ) {
+            list.insert(list.end(), config->second.begin(), config->second.end());
         }
 
         for ( auto& a : list ) {
             raw_list.push_back(*a->raw());
         }
 
-        auto status = g_api.netif_api->create_network_interface(&id, m_id, raw_list.size(), raw_list.data());
+        auto status = g_service.load()->create(TAI_OBJECT_TYPE_NETWORKIF, m_id, raw_list, &id);
         if ( status != TAI_STATUS_SUCCESS ) {
             throw std::runtime_error("failed to create network interface");
         }
-        std::cout << "netif: 0x" << std::hex << id << std::endl;
+        std::stringstream ss;
+        ss << "netif: 0x" << std::hex << id;
+        log_line(ss);
         netifs[i] = id;
     }
     return 0;
 }
 
-void grpc_thread(std::string addr) {
-    TAIServiceImpl service(&g_api);
+// serves the stats of service in the Prometheus text exposition format over HTTP.
+// addr is a TCP port on the loopback interface or a Unix domain socket path
+static void stats_thread(TAIServiceImpl* service, std::string addr) {
+    int fd;
+    int ret;
+    if ( addr.find('/') != std::string::npos ) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un sa{.sun_family = AF_UNIX};
+        strncpy(sa.sun_path, addr.c_str(), sizeof(sa.sun_path) - 1);
+        unlink(addr.c_str());
+        ret = bind(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa));
+    } else {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in sa{};
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons(atoi(addr.c_str()));
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ret = bind(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa));
+    }
+    if ( fd < 0 || ret < 0 || listen(fd, 8) < 0 ) {
+        std::cerr << "failed to serve stats on " << addr << ": " << strerror(errno) << std::endl;
+        return;
+    }
+    std::cout << "Stats served on " << addr << std::endl;
+
+    while (true) {
+        auto c = accept(fd, nullptr, nullptr);
+        if ( c < 0 ) {
+            continue;
+        }
+        // the request is not parsed. any request gets the stats
+        timeval tv{.tv_sec = 1};
+        setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        char buf[1024];
+        if ( read(c, buf, sizeof(buf)) < 0 ) {
+            close(c);
+            continue;
+        }
+        auto body = service->stats_text();
+        std::stringstream ss;
+        ss << "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " << body.size() << "\r\n\r\n" << body;
+        auto res = ss.str();
+        size_t n = 0;
+        while ( n < res.size() ) {
+            auto v = write(c, res.data() + n, res.size() - n);
+            if ( v <= 0 ) {
+                break;
+            }
+            n += v;
+        }
+        close(c);
+    }
+}
+
+void grpc_thread(grpc_option_t option, std::promise<void>* ready) {
+    TAIServiceImpl service(&g_api, option.service);
+    g_service = &service;
+    ready->set_value();
+
+    if ( option.stats_addr != "" ) {
+        std::thread(stats_thread, &service, option.stats_addr).detach();
+    }
 
     ServerBuilder builder;
-    builder.AddListeningPort(grpc::string(addr), grpc::InsecureServerCredentials());
+    builder.AddListeningPort(grpc::string(option.addr), grpc::InsecureServerCredentials());
+    if ( option.unix_path != "" ) {
+        builder.AddListeningPort("unix:" + option.unix_path, grpc::InsecureServerCredentials());
+        std::cout << "Server listening on unix:" << option.unix_path << std::endl;
+    }
+
+    if ( option.async ) {
+        TAIAsyncServiceImpl async_service(&service, option.num_pollers, option.num_workers);
+        async_service.register_service(builder);
+        auto server = builder.BuildAndStart();
+        async_service.start();
+        std::cout << "Server listening on " << option.addr << " (async, pollers: " << option.num_pollers << ", workers: " << option.num_workers << ")" << std::endl;
+        server->Wait();
+        return;
+    }
+
+    builder.SetSyncServerOption(ServerBuilder::SyncServerOption::NUM_CQS, option.num_pollers);
+    builder.SetSyncServerOption(ServerBuilder::SyncServerOption::MIN_POLLERS, option.num_pollers);
     builder.RegisterService(&service);
 
     auto server = builder.BuildAndStart();
-    std::cout << "Server listening on " << addr << std::endl;
+    std::cout << "Server listening on " << option.addr << std::endl;
     server->Wait();
 }
 
-int start_grpc_server(std::string addr) {
-    std::thread th(grpc_thread, addr);
+// returns once g_service is set. the modules are brought up through it
+int start_grpc_server(grpc_option_t option) {
+    std::promise<void> ready;
+    std::thread th(grpc_thread, option, &ready);
     th.detach();
+    ready.get_future().wait();
     return 0;
 }
 
-// when type == module or is_create == false, index value is meaningless
-void object_update(tai_object_type_t type, tai_object_id_t oid, int index, bool is_create) {
+// m must be held
+static void apply_object_update(tai_object_type_t type, tai_object_id_t oid, int index, bool is_create) {
     if ( type == TAI_OBJECT_TYPE_MODULE ) {
         if ( is_create ) {
             tai_attribute_t attr;
@@ -297,11 +562,12 @@ void object_update(tai_object_type_t type, tai_object_id_t oid, int index, bool
                 return;
             }
             std::string loc(l, attr.value.charlist.count);
-            auto m = g_modules[loc];
-            if ( m == nullptr ) {
+            // the module may still be being brought up
+            auto it = g_modules.find(loc);
+            if ( it == g_modules.end() ) {
                 return;
             }
-            m->set_id(oid);
+            it->second->set_id(oid);
         } else {
             for ( auto& m : g_modules ) {
                 if ( m.second->id() == oid ) {
@@ -315,7 +581,7 @@ void object_update(tai_object_type_t type, tai_object_id_t oid, int index, bool
 
     auto mid = tai_module_id_query(oid);
 
-    std::map<int, tai_object_id_t> *v;
+    std::map<int, tai_object_id_t> *v = nullptr;
 
     for (auto& m : g_modules) {
         if (is_create && m.second->id() != mid) {
@@ -326,6 +592,8 @@ void object_update(tai_object_type_t type, tai_object_id_t oid, int index, bool
             v = &m.second->hostifs;
         } else if (type == TAI_OBJECT_TYPE_NETWORKIF) {
             v = &m.second->netifs;
+        } else {
+            return;
         }
 
         if (is_create) {
@@ -348,8 +616,8 @@ void object_update(tai_object_type_t type, tai_object_id_t oid, int index, bool
     }
 }
 
-tai_status_t list_module(std::vector<tai_api_module_t>& l) {
-    std::lock_guard<std::mutex> g(m);
+// m must be held
+static void collect_modules(std::vector<tai_api_module_t>& l) {
     for ( auto v : g_modules ) {
         tai_api_module_t list;
         list.location = v.first;
@@ -360,6 +628,119 @@ tai_status_t list_module(std::vector<tai_api_module_t>& l) {
         list.netifs = m->netifs;
         l.emplace_back(list);
     }
+}
+
+// reads the oper-status of the modules through the service, so that the reads take the adapter
+// lock against the calls of the clients. m must not be held, the reads may wait for those calls
+static std::map<tai_object_id_t, std::string> oper_status() {
+    std::map<tai_object_id_t, std::vector<tai_attr_id_t>> objects;
+    {
+        std::lock_guard<std::mutex> g(m);
+        for ( auto& v : g_modules ) {
+            if ( v.second->id() != TAI_NULL_OBJECT_ID ) {
+                objects[v.second->id()] = {TAI_MODULE_ATTR_OPER_STATUS};
+            }
+        }
+    }
+    std::map<tai_object_id_t, std::vector<tai::S_Attribute>> values;
+    g_service.load()->read_attributes(objects, &values);
+    std::map<tai_object_id_t, std::string> status;
+    tai_serialize_option_t option{true, true, false};
+    for ( auto& v : values ) {
+        auto& attr = v.second.front();
+        status[v.first] = attr == nullptr ? "unknown" : attr->to_string(&option);
+    }
+    return status;
+}
+
+// writes the object ids and the applied config of the modules taish_server created, so that the
+// next start can reattach to them. status adds the oper-status of the modules read by
+// oper_status(). m must be held. returns -1 on failure
+static int save_journal(const std::map<tai_object_id_t, std::string>* status = nullptr) {
+    if ( g_journal_file == "" ) {
+        return -1;
+    }
+    json modules = json::object();
+    for ( auto& v : g_modules ) {
+        auto mod = v.second;
+        if ( mod->id() == TAI_NULL_OBJECT_ID || mod->applied.is_null() ) {
+            continue;
+        }
+        json j = {{"oid", mod->id()}, {"config", mod->applied}, {"hostif", json::object()}, {"netif", json::object()}};
+        for ( auto& h : mod->hostifs ) {
+            j["hostif"][std::to_string(h.first)] = h.second;
+        }
+        for ( auto& n : mod->netifs ) {
+            j["netif"][std::to_string(n.first)] = n.second;
+        }
+        if ( status != nullptr ) {
+            auto it = status->find(mod->id());
+            j["oper-status"] = it == status->end() ? "unknown" : it->second;
+        }
+        modules[v.first] = j;
+    }
+    // the journal is replaced at once so that a crash while writing leaves the previous one.
+    // the temporary file is synced first, otherwise the rename may reach the disk before its data
+    auto tmp = g_journal_file + ".tmp";
+    auto data = json{{"modules", modules}}.dump();
+    auto fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if ( fd < 0 ) {
+        return -1;
+    }
+    size_t written = 0;
+    while ( written < data.size() ) {
+        auto n = write(fd, data.data() + written, data.size() - written);
+        if ( n < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            break;
+        }
+        written += n;
+    }
+    if ( written < data.size() || fsync(fd) < 0 ) {
+        close(fd);
+        return -1;
+    }
+    if ( close(fd) < 0 ) {
+        return -1;
+    }
+    return rename(tmp.c_str(), g_journal_file.c_str());
+}
+
+// m must be held. writes the journal when the objects changed since it was last written.
+// the main loop calls this once per iteration, so that a bring-up or a batch of changes is
+// written at once
+static void flush_journal() {
+    if ( !g_journal_dirty || g_journal_file == "" ) {
+        return;
+    }
+    g_journal_dirty = false;
+    if ( save_journal() < 0 ) {
+        std::cout << "failed to write the journal " << g_journal_file << std::endl;
+    }
+}
+
+// m must be held. ListModule and WatchTopology read the published snapshot without taking m
+static void publish_topology() {
+    std::vector<tai_api_module_t> l;
+    collect_modules(l);
+    g_topology.publish(l);
+    g_journal_dirty = true;
+}
+
+// when type == module or is_create == false, index value is meaningless
+void object_update(tai_object_type_t type, tai_object_id_t oid, int index, bool is_create) {
+    uint64_t v = 1;
+    std::lock_guard<std::mutex> g(m);
+    apply_object_update(type, oid, index, is_create);
+    publish_topology();
+    v = write(journal_fd, &v, sizeof(uint64_t));
+}
+
+tai_status_t list_module(std::vector<tai_api_module_t>& l) {
+    std::lock_guard<std::mutex> g(m);
+    collect_modules(l);
     return TAI_STATUS_SUCCESS;
 }
 
@@ -391,35 +772,406 @@ static void log_cb(tai_log_level_t lvl, const char *file, int line, const char *
     std::cout << std::endl;
 }
 
-void signal_handler(int sig) {
-    uint64_t v = 1;
+// hash is set to the hash of the file content
+static json read_config(const std::string& file, uint64_t& hash) {
+    std::ifstream ifs(file);
+    if ( !ifs ) {
+        throw std::runtime_error("failed to open config file: " + file);
+    }
+    std::istreambuf_iterator<char> it(ifs), last;
+    std::string text(it, last);
+    hash = tai_config_hash(text);
+    auto config = json::parse(text);
+    if ( !config.is_object() ) {
+        throw std::runtime_error("invalid configuration. config is not object");
+    }
+    return config;
+}
+
+// keys the config cache with the hash of the config file and the metadata of the objects at the
+// locations in the config, so that the cache is compiled again when either of them changes
+static uint64_t config_cache_key(const json& config, uint64_t hash) {
+    auto put = [&](const void* data, size_t size) {
+        hash = tai_config_hash(data, size, hash);
+    };
+    for ( auto& c : config.items() ) {
+        auto& l = c.key();
+        tai_char_list_t location{.count = static_cast<uint32_t>(l.size()), .list = const_cast<char*>(l.c_str())};
+        for ( auto t : {TAI_OBJECT_TYPE_MODULE, TAI_OBJECT_TYPE_HOSTIF, TAI_OBJECT_TYPE_NETWORKIF} ) {
+            tai_metadata_key_t key{.type = t, .location = location};
+            const tai_object_type_info_t* info = nullptr;
+            if ( g_api.meta_api != nullptr && g_api.meta_api->get_object_info != nullptr ) {
+                info = g_api.meta_api->get_object_info(&key);
+            } else {
+                info = tai_metadata_get_object_type_info(t);
+            }
+            put(l.data(), l.size());
+            put(&t, sizeof(t));
+            if ( info == nullptr ) {
+                continue;
+            }
+            for ( size_t i = 0; i < info->attrmetadatalength; i++ ) {
+                auto meta = info->attrmetadata[i];
+                put(&meta->attrid, sizeof(meta->attrid));
+                put(meta->attridname, strlen(meta->attridname));
+                put(&meta->attrvaluetype, sizeof(meta->attrvaluetype));
+                if ( meta->enummetadata == nullptr ) {
+                    continue;
+                }
+                for ( size_t j = 0; j < meta->enummetadata->valuescount; j++ ) {
+                    put(&meta->enummetadata->values[j], sizeof(int));
+                    put(meta->enummetadata->valuesnames[j], strlen(meta->enummetadata->valuesnames[j]));
+                }
+            }
+        }
+    }
+    return hash;
+}
+
+static const tai_attr_metadata_t* config_cache_metadata(tai_object_type_t type, const std::string& l, tai_attr_id_t id) {
+    tai_char_list_t location{.count = static_cast<uint32_t>(l.size()), .list = const_cast<char*>(l.c_str())};
+    tai_metadata_key_t key{.type = type, .location = location};
+    return get_metadata(g_api.meta_api, &key, id);
+}
+
+// the "attrs" of the object at path in a module config. an empty object when there are none
+static json attrs_at(const json& config, const std::string& path) {
+    try {
+        auto& a = config.at(json::json_pointer(path + "/attrs"));
+        if ( a.is_object() ) {
+            return a;
+        }
+    } catch ( json::exception& ) {
+    }
+    return json::object();
+}
+
+// sets the attributes which differ between before and after with one set_*_attributes call.
+// the attributes only in before are left as they are. returns false when setting failed
+static bool reload_object(TAIServiceImpl* service, tai_object_type_t t, tai_object_id_t oid, const std::string& location, const std::string& name, const json& before, const json& after) {
+    std::stringstream ss;
+    ss << name << " 0x" << std::hex << oid << " of module " << location << ": ";
+    auto prefix = ss.str();
+    for ( auto& a : before.items() ) {
+        if ( after.find(a.key()) == after.end() ) {
+            ss.str("");
+            ss << prefix << a.key() << " is removed from the config. left as it is";
+            log_line(ss);
+        }
+    }
+    json changed = json::object();
+    for ( auto& a : after.items() ) {
+        auto b = before.find(a.key());
+        if ( b == before.end() || *b != a.value() ) {
+            changed[a.key()] = a.value();
+        }
+    }
+    if ( changed.empty() ) {
+        return true;
+    }
+    std::vector<tai::S_Attribute> list;
+    ss.str("");
+    ss << prefix;
+    try {
+        load_config(json{{"attrs", changed}}, list, t, location);
+    } catch ( std::exception& e ) {
+        ss << "invalid config: " << e.what();
+        log_line(ss);
+        return false;
+    }
+    auto status = service->set_attributes(oid, list);
+    if ( status != TAI_STATUS_SUCCESS ) {
+        ss << "failed to set " << changed.dump() << ", err: " << status;
+        log_line(ss);
+        return false;
+    }
+    ss << "set " << changed.dump();
+    log_line(ss);
+    return true;
+}
+
+// applies the difference between the config applied to the modules and config, one
+// set_*_attributes call per object. m must not be held since the adapter calls may take long
+static void reload_config(const json& config) {
+    auto service = g_service.load();
+    struct target {
+        module* mod;
+        tai_object_id_t id;
+        std::map<int, tai_object_id_t> hostifs, netifs;
+        json before; // the applied config, copied under m
+    };
+    std::vector<target> targets;
+    {
+        std::lock_guard<std::mutex> g(m);
+        for ( auto& v : g_modules ) {
+            auto mod = v.second;
+            if ( mod->id() != TAI_NULL_OBJECT_ID && !mod->applied.is_null() ) {
+                targets.emplace_back(target{mod, mod->id(), mod->hostifs, mod->netifs, mod->applied});
+            }
+        }
+    }
+    for ( auto& t : targets ) {
+        auto& loc = t.mod->location();
+        auto& before = t.before;
+        auto c = config.find(loc);
+        json after = c != config.end() && c->is_object() ? *c : json::object();
+        // the objects which failed keep the attributes applied before so that the next reload retries them
+        auto reload = [&](tai_object_type_t type, tai_object_id_t oid, const std::string& name, const std::string& path) {
+            auto b = attrs_at(before, path);
+            if ( !reload_object(service, type, oid, loc, name, b, attrs_at(after, path)) ) {
+                after[json::json_pointer(path + "/attrs")] = b;
+            }
+        };
+        try {
+            reload(TAI_OBJECT_TYPE_MODULE, t.id, "module", "");
+            for ( auto& h : t.hostifs ) {
+                reload(TAI_OBJECT_TYPE_HOSTIF, h.second, "hostif", "/hostif/" + std::to_string(h.first));
+            }
+            for ( auto& n : t.netifs ) {
+                reload(TAI_OBJECT_TYPE_NETWORKIF, n.second, "netif", "/netif/" + std::to_string(n.first));
+            }
+            std::lock_guard<std::mutex> g(m);
+            t.mod->applied = after;
+        } catch ( json::exception& e ) {
+            std::cout << "invalid config of module " << loc << ": " << e.what() << std::endl;
+        }
+    }
     std::lock_guard<std::mutex> g(m);
-    q.push(std::pair<bool, std::string>(false, std::string("shutdown")));
-    v = write(event_fd, &v, sizeof(uint64_t));
+    g_journal_dirty = true;
+}
+
+// logs whether the objects of a journaled module came back with the ids they had before the restart
+static void check_reattached(const std::string& loc, module& mod, const json& journaled) {
+    std::stringstream ss;
+    std::vector<std::string> moved;
+    auto check = [&](const std::string& name, tai_object_id_t before, tai_object_id_t after) {
+        if ( before != after ) {
+            std::stringstream m;
+            m << name << " 0x" << std::hex << before << " -> 0x" << after;
+            moved.emplace_back(m.str());
+        }
+    };
+    try {
+        check("module", journaled.at("oid").get<tai_object_id_t>(), mod.id());
+        for ( auto& h : journaled.at("hostif").items() ) {
+            auto it = mod.hostifs.find(std::stoi(h.key()));
+            check("hostif " + h.key(), h.value().get<tai_object_id_t>(), it != mod.hostifs.end() ? it->second : TAI_NULL_OBJECT_ID);
+        }
+        for ( auto& n : journaled.at("netif").items() ) {
+            auto it = mod.netifs.find(std::stoi(n.key()));
+            check("netif " + n.key(), n.value().get<tai_object_id_t>(), it != mod.netifs.end() ? it->second : TAI_NULL_OBJECT_ID);
+        }
+    } catch ( std::exception& e ) {
+        moved.emplace_back(std::string("broken journal: ") + e.what());
+    }
+    auto state = journaled.find("oper-status");
+    if ( moved.empty() ) {
+        ss << "reattached module " << loc << " (oper-status before the restart: " << (state != journaled.end() ? state->get<std::string>() : "unknown") << ")";
+    } else {
+        ss << "module " << loc << " was not reattached as it was:";
+        for ( auto& m : moved ) {
+            ss << " " << m;
+        }
+    }
+    log_line(ss);
+}
+
+// creates the modules of the locations on a worker pool, one task per location. m must not be held.
+// a module is published as soon as it is brought up
+static void bring_up(const std::map<std::string, bool>& locations, const json& config, bool auto_creation, int num_workers) {
+    if ( locations.empty() ) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<bool> reattached{false};
+    {
+        TAIWorkerPool pool(std::min<int>(num_workers, locations.size()));
+        for ( auto& l : locations ) {
+            auto loc = l.first;
+            auto present = l.second;
+            auto c = config.find(loc);
+            auto mc = c != config.end() ? *c : json();
+            // a journaled module is created again with the config it had, which the hardware still has
+            auto j = g_journal.find(loc);
+            auto journaled = auto_creation && j != g_journal.end() ? *j : json();
+            pool.push([loc, present, mc, auto_creation, journaled, &reattached]() {
+                auto start = std::chrono::steady_clock::now();
+                auto mod = journaled.is_null() ? new module(loc, mc, auto_creation) : new module(loc, journaled["config"], auto_creation, false, true);
+                if ( auto_creation ) {
+                    std::stringstream ss;
+                    ss << std::fixed << std::setprecision(1) << "brought up module " << loc << " in " << elapsed_ms(start) << "ms (module: " << mod->module_ms << "ms, hostif: " << mod->hostif_ms << "ms, netif: " << mod->netif_ms << "ms, config: " << (!journaled.is_null() ? "journaled" : mod->config_cached ? "cached" : "compiled") << ")";
+                    log_line(ss);
+                }
+                if ( !journaled.is_null() ) {
+                    check_reattached(loc, *mod, journaled);
+                    reattached = true;
+                }
+                std::lock_guard<std::mutex> g(m);
+                mod->present = present;
+                g_modules[loc] = mod;
+                publish_topology();
+            });
+        }
+        pool.stop();
+    }
+    // the changes made to the config file while taish_server was down
+    if ( reattached ) {
+        reload_config(config);
+    }
+    if ( auto_creation ) {
+        if ( g_config_cache.save() < 0 ) {
+            std::cout << "failed to save the config cache" << std::endl;
+        }
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1) << "brought up " << locations.size() << " modules in " << elapsed_ms(start) << "ms (workers: " << std::min<int>(num_workers, locations.size()) << ")";
+        log_line(ss);
+    }
+}
+
+// drains the module_presence calls queued so far in one pass. the presence of the known modules
+// is published once and the new ones are brought up together
+static void apply_presence(const json& config, bool auto_creation, int num_workers) {
+    std::map<std::string, bool> locations; // the locations which appeared, and their presence
+    {
+        std::lock_guard<std::mutex> g(m);
+        auto updated = false;
+        while ( !q.empty() ) {
+            auto p = q.front();
+            auto loc = p.second;
+            q.pop();
+            std::cout << "present: " << p.first << ", loc: " << loc << std::endl;
+            auto it = g_modules.find(loc);
+            if ( it == g_modules.end() ) {
+                locations[loc] = p.first;
+                continue;
+            }
+            it->second->present = p.first;
+            updated = true;
+        }
+        if ( updated ) {
+            publish_topology();
+        }
+    }
+    bring_up(locations, config, auto_creation, num_workers);
+}
+
+// the modules which appear from now on are brought up with the reloaded config
+static void reload(const std::string& config_file, json& config) {
+    if ( config_file == "" ) {
+        return;
+    }
+    std::cout << "reloading config file: " << config_file << std::endl;
+    try {
+        uint64_t hash;
+        auto c = read_config(config_file, hash);
+        reload_config(c);
+        g_config_cache.reset(config_cache_key(c, hash));
+        config = c;
+    } catch ( std::exception& e ) {
+        std::cout << "config is not reloaded: " << e.what() << std::endl;
+    }
+}
+
+// the main loop. module_presence wakes it up through event_fd and arms the debounce timer,
+// object_update wakes it up through journal_fd to write the journal, SIGHUP reloads the config
+// and SIGINT/SIGTERM end it. returns -1 on error
+static int run(int signal_fd, const std::string& config_file, json& config, bool auto_creation, int num_workers) {
+    auto epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    auto timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if ( epoll_fd < 0 || timer_fd < 0 ) {
+        std::cout << "failed to create the main loop: " << strerror(errno) << std::endl;
+        return -1;
+    }
+    for ( auto fd : {event_fd, journal_fd, signal_fd, timer_fd} ) {
+        epoll_event ev{.events = EPOLLIN};
+        ev.data.fd = fd;
+        if ( epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0 ) {
+            std::cout << "failed to create the main loop: " << strerror(errno) << std::endl;
+            return -1;
+        }
+    }
+
+    auto armed = false; // the debounce timer is running
+    while (true) {
+        epoll_event events[4];
+        auto n = epoll_wait(epoll_fd, events, 4, -1);
+        if ( n < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            std::cout << "main loop failed: " << strerror(errno) << std::endl;
+            return -1;
+        }
+        auto presence = false, reloading = false;
+        for ( int i = 0; i < n; i++ ) {
+            auto fd = events[i].data.fd;
+            if ( fd == event_fd ) {
+                uint64_t v;
+                if ( read(event_fd, &v, sizeof(v)) > 0 && !armed ) {
+                    itimerspec t{};
+                    auto d = std::chrono::nanoseconds(TAI_PRESENCE_DEBOUNCE).count();
+                    t.it_value.tv_sec = d / 1000000000;
+                    t.it_value.tv_nsec = d % 1000000000;
+                    timerfd_settime(timer_fd, 0, &t, nullptr);
+                    armed = true;
+                }
+            } else if ( fd == journal_fd ) {
+                uint64_t v;
+                v = read(journal_fd, &v, sizeof(v));
+            } else if ( fd == timer_fd ) {
+                uint64_t v;
+                if ( read(timer_fd, &v, sizeof(v)) > 0 ) {
+                    armed = false;
+                    presence = true;
+                }
+            } else if ( fd == signal_fd ) {
+                signalfd_siginfo info;
+                while ( read(signal_fd, &info, sizeof(info)) == sizeof(info) ) {
+                    if ( info.ssi_signo == SIGHUP ) {
+                        reloading = true;
+                    } else {
+                        return 0;
+                    }
+                }
+            }
+        }
+        if ( reloading ) {
+            reload(config_file, config);
+        }
+        if ( presence ) {
+            apply_presence(config, auto_creation, num_workers);
+        }
+        std::lock_guard<std::mutex> g(m);
+        flush_journal();
+    }
 }
 
 int main(int argc, char *argv[]) {
 
     auto ip = TAI_RPC_DEFAULT_IP;
     auto port = TAI_RPC_DEFAULT_PORT;
-    std::string config_file;
+    std::string config_file, config_cache_file, record_file;
+    uint64_t flags = 0;
     int c, ret = -1;
     tai_log_level_t level = TAI_LOG_LEVEL_INFO;
     auto auto_creation = true;
+    grpc_option_t grpc_option{.async = false, .num_pollers = TAI_RPC_DEFAULT_NUM_POLLERS, .num_workers = TAI_RPC_DEFAULT_NUM_WORKERS};
     json config;
     std::stringstream ss;
 
-    if ( signal(SIGINT, signal_handler) == SIG_ERR ) {
-        std::cerr << "failed to register signal handler" << std::endl;
+    // the signals are blocked before any thread starts, so that they are only delivered to the main loop
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    auto signal_fd = -1;
+    if ( pthread_sigmask(SIG_BLOCK, &signals, nullptr) != 0 || (signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC)) < 0 ) {
+        std::cerr << "failed to handle signals" << std::endl;
         return 1;
     }
 
-    if ( signal(SIGTERM, signal_handler) == SIG_ERR ) {
-        std::cerr << "failed to register signal handler" << std::endl;
-        return 1;
-    }
-
-    while ((c = getopt (argc, argv, "i:p:f:vn")) != -1) {
+    while ((c = getopt (argc, argv, "i:p:u:f:C:J:vnaP:W:mS:R:")) != -1) {
       switch (c) {
       case 'i':
         ip = std::string(optarg);
@@ -433,6 +1185,14 @@ int main(int argc, char *argv[]) {
         config_file = std::string(optarg);
         break;
 
+      case 'C':
+        config_cache_file = std::string(optarg);
+        break;
+
+      case 'J':
+        g_journal_file = std::string(optarg);
+        break;
+
       case 'v':
         level = TAI_LOG_LEVEL_DEBUG;
         break;
@@ -441,8 +1201,36 @@ int main(int argc, char *argv[]) {
         auto_creation = false;
         break;
 
+      case 'a':
+        grpc_option.async = true;
+        break;
+
+      case 'P':
+        grpc_option.num_pollers = atoi(optarg);
+        break;
+
+      case 'W':
+        grpc_option.num_workers = atoi(optarg);
+        break;
+
+      case 'm':
+        grpc_option.service.module_thread_safe = true;
+        break;
+
+      case 'u':
+        grpc_option.unix_path = std::string(optarg);
+        break;
+
+      case 'S':
+        grpc_option.stats_addr = std::string(optarg);
+        break;
+
+      case 'R':
+        record_file = std::string(optarg);
+        break;
+
       default:
-        std::cerr << "usage: " << argv[0] << "-i <IP address> -p <Port number> -f <Config file> -v -n" << std::endl;
+        std::cerr << "usage: " << argv[0] << "-i <IP address> -p <Port number> -u <Unix domain socket path> -f <Config file> -C <Config cache file> -J <Journal file> -v -n -a -P <Number of pollers> -W <Number of adapter workers> -m -S <Stats port or Unix socket path> -R <Record file>" << std::endl;
         return 1;
       }
     }
@@ -450,8 +1238,24 @@ int main(int argc, char *argv[]) {
     tai_service_method_table_t services = {0};
     services.module_presence = module_presence;
     event_fd = eventfd(0, 0);
+    journal_fd = eventfd(0, 0);
+
+    if ( g_journal_file != "" ) {
+        std::ifstream ifs(g_journal_file);
+        if ( ifs ) {
+            try {
+                std::istreambuf_iterator<char> it(ifs), last;
+                g_journal = json::parse(std::string(it, last)).at("modules");
+                flags |= TAI_API_INITIALIZE_FLAG_WARM_RESTART;
+                std::cout << "warm restart: reattaching to " << g_journal.size() << " modules in " << g_journal_file << std::endl;
+            } catch ( std::exception& e ) {
+                g_journal = json::object();
+                std::cout << "ignoring the broken journal " << g_journal_file << ": " << e.what() << std::endl;
+            }
+        }
+    }
 
-    auto status = tai_api_initialize(0, &services);
+    auto status = tai_api_initialize(flags, &services);
     if ( status != TAI_STATUS_SUCCESS ) {
         std::cout << "failed to initialize" << std::endl;
         goto exit;
@@ -489,48 +1293,76 @@ int main(int argc, char *argv[]) {
     g_api.list_module = list_module;
     g_api.object_update = object_update;
 
-    ss << ip << ":" << port;
-    start_grpc_server(ss.str());
+    if ( grpc_option.num_pollers < 1 || grpc_option.num_workers < 1 ) {
+        std::cerr << "number of pollers and workers must be greater than 0" << std::endl;
+        goto exit;
+    }
 
     if ( config_file != "" ) {
-        std::ifstream ifs(config_file);
-        if ( !ifs ) {
-            std::cout << "failed to open config file: " << config_file << std::endl;
+        uint64_t hash;
+        try {
+            config = read_config(config_file, hash);
+        } catch ( std::exception& e ) {
+            std::cout << e.what() << std::endl;
+            goto exit;
+        }
+
+        if ( config_cache_file != "" ) {
+            auto n = g_config_cache.open(config_cache_file, config_cache_key(config, hash), config_cache_metadata);
+            if ( n < 0 ) {
+                std::cout << "compiling the config into " << config_cache_file << std::endl;
+            } else {
+                std::cout << "read the config of " << n << " modules from " << config_cache_file << std::endl;
+            }
+        }
+
+        try {
+            load_cache_policy(config, grpc_option.service.cache);
+        } catch ( std::exception& e ) {
+            std::cout << "invalid cache configuration: " << e.what() << std::endl;
             goto exit;
         }
 
-        std::istreambuf_iterator<char> it(ifs), last;
-        std::string c(it, last);
-        config = json::parse(c);
-        if ( !config.is_object() ) {
-            std::cout << "invalid configuration. config is not object" << std::endl;
+        try {
+            load_admission_policy(config, grpc_option.service.admission);
+        } catch ( std::exception& e ) {
+            std::cout << "invalid admission configuration: " << e.what() << std::endl;
             goto exit;
         }
     }
 
-    while (true) {
-        uint64_t v;
-        v = read(event_fd, &v, sizeof(uint64_t));
-        {
-            std::lock_guard<std::mutex> g(m);
-            while ( !q.empty() ) {
-                auto p = q.front();
-                auto loc = p.second;
-                if ( loc == "shutdown" ) {
-                    ret = 0;
-                    goto exit;
-                }
-                std::cout << "present: " << p.first << ", loc: " << loc << std::endl;
-                if ( g_modules.find(loc) == g_modules.end() ) {
-                    auto m = new module(loc, config[loc], auto_creation);
-                    g_modules[loc] = m;
-                }
-                g_modules[loc]->present = p.first;
-                q.pop();
-            }
+    if ( record_file != "" ) {
+        if ( g_recorder.open(record_file) < 0 ) {
+            std::cout << "failed to open record file: " << record_file << std::endl;
+            goto exit;
+        }
+        grpc_option.service.recorder = &g_recorder;
+    }
+
+    grpc_option.service.topology = &g_topology;
+
+    ss << ip << ":" << port;
+    grpc_option.addr = ss.str();
+    start_grpc_server(grpc_option);
+
+    ret = run(signal_fd, config_file, config, auto_creation, grpc_option.num_workers);
+
+    // with the journal, the objects are left as they are for the next start to reattach to them
+    if ( ret == 0 && g_journal_file != "" ) {
+        auto status = oper_status();
+        std::lock_guard<std::mutex> g(m);
+        if ( save_journal(&status) == 0 ) {
+            std::cout << "left the modules running for a warm restart" << std::endl;
+            g_recorder.close();
+            // tai_api_uninitialize() is skipped on purpose: it removes the modules, which must keep
+            // running for the next start. the gRPC server is not shut down either, its threads end
+            // with the process and the clients see the connection drop as they do on a crash
+            _exit(0);
         }
+        std::cout << "failed to write the journal. tearing down the modules" << std::endl;
     }
 exit:
+    g_recorder.close();
     tai_api_uninitialize();
     return ret;
 }